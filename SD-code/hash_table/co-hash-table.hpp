@@ -1,10 +1,23 @@
 #pragma once
 
+#include "prefetch.hpp"
+#include "hash-table-stats.hpp"
+#include "hash-functions.hpp"
+#include "parallel-for.hpp"
+
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <tuple>
+#include <cassert>
 
 
 /// Closed addressing hash table, templated by key, value and hash of key
+/// Each element keeps its full hash, so resize does not call the hasher and lookups compare keys only on hash match
+/// If Hash has is_transparent member type, find also accepts any type the hasher and K can compare with
+/// The number of buckets is always power of 2 and the bucket is picked with fibonacciIndex
 template <typename K, typename T, typename Hash = std::hash<K>>
 class COHashTable {
 public:
@@ -15,72 +28,207 @@ public:
 
 	typedef value_type & reference;
 private:
-	typedef std::vector<pair_type> bucket_type;
+	struct Element {
+		pair_type data; ///< Key value pair, must be first so iterators can cast Element to pair
+		size_t hash; ///< Cached hasher(data.first)
+
+		/// Construct the key from key and the value from valueArgs directly in place
+		template <typename KeyArg, typename... Args>
+		Element(size_t hash, KeyArg &&key, Args &&...valueArgs)
+			: data(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)), std::forward_as_tuple(std::forward<Args>(valueArgs)...))
+			, hash(hash) {}
+	};
+
+	typedef std::vector<Element> bucket_type;
 	typedef std::vector<bucket_type> table_type;
 
 	typedef typename bucket_type::iterator element_iterator;
 	typedef typename table_type::iterator bucket_iterator;
 
+	static constexpr int minBits = 5; ///< log2 of the smallest and initial number of buckets
+
 	table_type table; /// The table data
+	int bits; ///< table.size() == 1 << bits
+	table_type oldTable; ///< Table being migrated into table during incremental resize, empty otherwise
+	int oldBits; ///< oldTable.size() == 1 << oldBits while migrating
+	int migrated; ///< Number of buckets from oldTable already moved into table
+	int migrateStep; ///< Buckets to migrate on each operation, 0 to resize in one go
+	int resizeThreads; ///< Threads moving the elements in a full resize
 	int count; ///< Number of elements inserted in the table
+	float maxLoad; ///< Table grows when the load factor goes above this
 	Hash hasher; ///< Hasher object
+#ifdef HASH_TABLE_STATS
+	HashTableCounters counters; ///< Operation counters reported by stats()
+#endif
 
-	/// Get the bucket index for a given key
-	int index(const K &key) const {
-		return hasher(key) % table.size();
+	/// Get the bucket index for a given hash
+	int index(size_t hash) const {
+		return fibonacciIndex(hash, bits);
 	}
 
-	/// Get iterator to the bucket for a given key, always valid iterator
-	bucket_iterator getBucket(const K &key) {
-		return table.begin() + index(key);
+	/// Get iterator to the bucket for a given hash, always valid iterator
+	bucket_iterator getBucket(size_t hash) {
+		return table.begin() + index(hash);
 	}
 
 	/// Check if table has reached maxLoadFactor
 	bool shouldResize() {
 		const float load = float(count) / table.size();
-		return load > 0.7;
+		return load > maxLoad;
 	}
 
-	/// Allocate more space and re-hash the table
+	/// Smallest log2 of bucket count that holds n elements without going above the max load factor
+	int bitsFor(long long n) const {
+		int result = minBits;
+		while (double(n) > double(1ll << result) * maxLoad) {
+			++result;
+		}
+		return result;
+	}
+
+	/// Double the table size, with incremental resize enabled the elements are moved by the next operations
 	void resize() {
-		table_type newTable(table.size() * 2 + 1);
+		rehashTo(bits + 1, migrateStep != 0);
+	}
+
+	/// Allocate table with 2^newBits buckets and move all elements there, now or during the next operations if incremental
+	void rehashTo(int newBits, bool incremental) {
+		HASH_TABLE_COUNT(const double rehashStart = HashTableCounters::nowMs());
+		HASH_TABLE_COUNT(++counters.resizes);
+		table_type newTable(size_t(1) << newBits);
 		// swap the tables now so we can use the private utility methods (index, getBucket)
 		table.swap(newTable);
+		const int newTableBits = bits;
+		bits = newBits;
+
+		// the previous migration is normally done by now, but make sure only one table is pending
+		moveBuckets(oldTable, migrated, oldTable.size());
+		if (incremental) {
+			// buckets will be moved on the next operations
+			oldTable.swap(newTable);
+			oldBits = newTableBits;
+			migrated = 0;
+			HASH_TABLE_COUNT(counters.rehashMs += HashTableCounters::nowMs() - rehashStart);
+			return;
+		}
+
+		table_type().swap(oldTable);
+		migrated = 0;
+		if (resizeThreads > 1 && int(newTable.size()) >= parallelResizeMinBuckets) {
+			// bucket indices are the top bits of the same product, so a range of source buckets maps to a range of
+			// destination buckets, when shrinking the ranges must not split the sources of one destination bucket
+			const int align = newTableBits > newBits ? 1 << (newTableBits - newBits) : 1;
+			parallelRanges(resizeThreads, int(newTable.size()), align, [this, &newTable](int from, int to) {
+				moveBuckets(newTable, from, to);
+			});
+		} else {
+			moveBuckets(newTable, 0, newTable.size());
+		}
+		HASH_TABLE_COUNT(counters.rehashMs += HashTableCounters::nowMs() - rehashStart);
+	}
 
-		for (bucket_type & bucket : newTable) {
-			for (pair_type & el : bucket) {
+	/// Move all elements from buckets [from, to) of source into the current table
+	void moveBuckets(table_type &source, int from, int to) {
+		for (int c = from; c < to; c++) {
+			bucket_type &bucket = source[c];
+			for (Element & el : bucket) {
 				// directly insert to avoid checking for duplicating keys
 				// since this is called only on valid elements, duplicate keys will not be present
-				getBucket(el.first)->push_back(std::make_pair(el.first, el.second));
+				getBucket(el.hash)->push_back(std::move(el));
 			}
 			// clear this source bucket since all elements from it are transferred to the new table
 			// this will allow the resize() method to only require O(n) + O(largestBucket) memory
-			bucket.clear();
+			bucket_type().swap(bucket);
 		}
 	}
 
+	/// Move the next migrateStep buckets of the old table, free it when all are moved
+	void migrate() {
+		if (oldTable.empty()) {
+			return;
+		}
+		const int to = std::min(migrated + migrateStep, int(oldTable.size()));
+		moveBuckets(oldTable, migrated, to);
+		migrated = to;
+		if (migrated == int(oldTable.size())) {
+			table_type().swap(oldTable);
+			migrated = 0;
+		}
+	}
+
+	/// Get iterator to the bucket of the old table for a given hash if that bucket is not yet migrated
+	/// otherwise returns oldTable.end()
+	bucket_iterator getOldBucket(size_t hash) {
+		if (oldTable.empty()) {
+			return oldTable.end();
+		}
+		const int idx = fibonacciIndex(hash, oldBits);
+		return idx < migrated ? oldTable.end() : oldTable.begin() + idx;
+	}
+
+	/// Find element in bucket by key and its hash, returns bucket->end() if key is not there
+	template <typename Key>
+	static element_iterator findInBucket(bucket_iterator bucket, const Key &key, size_t hash) {
+		for (element_iterator elIter = bucket->begin(); elIter != bucket->end(); ++elIter) {
+			if (elIter->hash == hash && elIter->data.first == key) {
+				return elIter;
+			}
+		}
+		return bucket->end();
+	}
+
 public:
 	COHashTable(Hash hasher = Hash())
-		: table(32)
+		: table(size_t(1) << minBits)
+		, bits(minBits)
+		, oldBits(0)
+		, migrated(0)
+		, migrateStep(0)
+		, resizeThreads(1)
 		, count(0)
+		, maxLoad(0.7f)
 		, hasher(hasher) {
 	}
 
 	void clear() {
-		table = table_type(32);
+		table = table_type(size_t(1) << minBits);
+		bits = minBits;
+		table_type().swap(oldTable);
+		migrated = 0;
 		count = 0;
 	}
 
+	/// Enable incremental resize, after the table grows the old buckets are moved bucketsPerOperation
+	/// at a time on each insert, find and erase by key, so no single operation re-hashes the whole table.
+	/// While buckets are migrating these operations invalidate iterators, same as insert does.
+	/// Pass 0 to re-hash the whole table at once (the default)
+	void setIncrementalResize(int bucketsPerOperation) {
+		if (bucketsPerOperation == 0) {
+			// finish any pending migration
+			migrateStep = oldTable.size();
+			migrate();
+		}
+		migrateStep = bucketsPerOperation;
+	}
+
+	/// Move the elements with up to threads threads when the whole table is re-hashed at once,
+	/// each thread takes a range of the old buckets and writes to its own range of new buckets, so no locks are needed
+	/// Tables below parallelResizeMinBuckets and incremental resize steps always use one thread
+	void setResizeThreads(int threads) {
+		resizeThreads = std::max(1, threads);
+	}
+
 	class iterator {
 		// friend the container so it can access the private constructors
 		friend class COHashTable;
 		
 		table_type *table; ///< Pointer so the iterators can be easily copy-able
+		table_type *next; ///< Table to continue with after the end of table, when iterating the old table
 		bucket_iterator bucket; ///< Iterator to the current bucket
 		element_iterator element; ///< Iterator to the current element
 
-		/// Creates the begin iterator for the given table
-		iterator(table_type &tableRef): table(&tableRef) {
+		/// Creates the begin iterator for the given table, continue with nextTable if it is not null
+		iterator(table_type &tableRef, table_type *nextTable): table(&tableRef), next(nextTable) {
 			// bucket will never be table->end(), because the table will always have some buckets
 			bucket = table->begin();
 			element = bucket->begin();
@@ -88,8 +236,9 @@ public:
 		}
 
 		/// Creates iterator to a specific element
-		iterator(table_type &table, bucket_iterator bucket, element_iterator element)
+		iterator(table_type &table, table_type *next, bucket_iterator bucket, element_iterator element)
 			: table(&table)
+			, next(next)
 			, bucket(bucket)
 			, element(element)
 		{}
@@ -100,8 +249,8 @@ public:
 
 		/// Get pair, but cast it to const key, so caller can't edit the key
 		const_pair & operator*() const {
-			// cast from pair_type -> to const_key_pair_type
-			// we can safely reinterpret this as they are binary the same 
+			// cast from Element -> to const_key_pair_type
+			// we can safely reinterpret this as data is the first member and pairs are binary the same
 			return reinterpret_cast<const_pair &>(*element);
 		}
 
@@ -146,72 +295,157 @@ public:
 				return;
 			}
 
-			// find first bucket with elements
-			do {
-				++bucket;
-			} while (bucket != table->end() && bucket->empty());
-
-			// if bucket reached table->end(), make this end() iterator
-			if (bucket != table->end()) {
-				element = bucket->begin();
-			} else {
-				element = table->back().end(); // end iterator
+			while (true) {
+				// find first bucket with elements
+				do {
+					++bucket;
+				} while (bucket != table->end() && bucket->empty());
+
+				if (bucket != table->end()) {
+					element = bucket->begin();
+					return;
+				}
+
+				// if bucket reached table->end() and there is no next table, make this end() iterator
+				if (!next) {
+					element = table->back().end(); // end iterator
+					return;
+				}
+
+				// continue from the first bucket of the next table
+				table = next;
+				next = nullptr;
+				bucket = table->begin();
+				if (!bucket->empty()) {
+					element = bucket->begin();
+					return;
+				}
 			}
 		}
 	};
 
 	/// Iterator to first element or end() if table is empty
 	iterator begin() {
-		return iterator(table);
+		// elements not yet migrated are visited first
+		if (!oldTable.empty()) {
+			return iterator(oldTable, &table);
+		}
+		return iterator(table, nullptr);
 	}
 
 	/// End iterator, can only be used for equality check
 	iterator end() {
-		return iterator(table, table.end(), table.back().end());
+		return iterator(table, nullptr, table.end(), table.back().end());
 	}
 
 	/// Find an element by its key, returns iterator to the element or end() if not found
 	iterator find(const K &key) {
-		bucket_iterator bucket = getBucket(key);
-		for (element_iterator elIter = bucket->begin(); elIter != bucket->end(); ++elIter) {
-			if (elIter->first == key) {
-				return iterator(table, bucket, elIter);
-			}
+		migrate();
+		const size_t hash = hasher(key);
+		iterator it = findHashed(key, hash, index(hash));
+		HASH_TABLE_COUNT(countFind(it));
+		return it;
+	}
+
+	/// Find an element by any key type that can be hashed and compared with K, only for transparent Hash
+	/// e.g. std::string_view or const char * with StringHash, does not construct K
+	template <typename Key, typename H = Hash, typename = typename H::is_transparent>
+	iterator find(const Key &key) {
+		migrate();
+		const size_t hash = hasher(key);
+		iterator it = findHashed(key, hash, index(hash));
+		HASH_TABLE_COUNT(countFind(it));
+		return it;
+	}
+
+	/// Find all keys, result[i] is the iterator for keys[i] or end()
+	/// All keys are hashed first and the buckets are prefetched ahead, so the cache misses overlap
+	void find_batch(const std::vector<K> &keys, std::vector<iterator> &result) {
+		// migrate only once, moving buckets would invalidate the iterators already in result
+		migrate();
+
+		std::vector<size_t> hashes(keys.size());
+		std::vector<int> indices(keys.size());
+		for (int c = 0; c < int(keys.size()); c++) {
+			hashes[c] = hasher(keys[c]);
+			indices[c] = index(hashes[c]);
+		}
+
+		result.clear();
+		result.reserve(keys.size());
+		for (int c = 0; c < int(keys.size()); c++) {
+			prefetchBuckets(indices, c);
+			result.push_back(findHashed(keys[c], hashes[c], indices[c]));
+			HASH_TABLE_COUNT(countFind(result.back()));
 		}
-		return end();
 	}
 
 	/// Insert key-value pair, if key is already present in the table, overwrites the value
 	iterator insert(const K &key, const T &value) {
-		// do check before inserting as it can invalidate iterators!
-		if (shouldResize()) {
-			resize();
-		}
+		return insertOrAssign(key, value);
+	}
 
-		bucket_iterator bucket = getBucket(key);
-		for (element_iterator elIter = bucket->begin(); elIter != bucket->end(); ++elIter) {
-			// if key matches, return iterator to it
-			if (elIter->first == key) {
-				// overwrite the value
-				elIter->second = value;
-				return iterator(table, bucket, elIter);
-			}
+	/// Same as insert, but the key and value are moved into the table instead of copied
+	iterator insert(K &&key, T &&value) {
+		return insertOrAssign(std::move(key), std::move(value));
+	}
+
+	iterator insert(const K &key, T &&value) {
+		return insertOrAssign(key, std::move(value));
+	}
+
+	iterator insert(K &&key, const T &value) {
+		return insertOrAssign(std::move(key), value);
+	}
+
+	/// If key is missing insert it with value constructed in place from args, otherwise do nothing
+	/// Returns iterator to the element for key and true if it was inserted, args are not used if key is present
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+		return tryEmplace(key, std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(K &&key, Args &&...args) {
+		return tryEmplace(std::move(key), std::forward<Args>(args)...);
+	}
+
+	/// Construct key-value pair from args and insert it if the key is missing, the value is not overwritten
+	/// The pair is constructed before the lookup, prefer try_emplace when the key is available
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args &&...args) {
+		pair_type item(std::forward<Args>(args)...);
+		return tryEmplace(std::move(item.first), std::move(item.second));
+	}
+
+	/// Insert all key-value pairs, same as insert for each one, but with the buckets prefetched ahead
+	void insert_batch(const std::vector<pair_type> &items) {
+		HASH_TABLE_COUNT(counters.inserts += items.size());
+		// resize for the whole batch before starting, so the prefetched buckets stay valid
+		reserve(count + items.size());
+		migrate();
+
+		std::vector<size_t> hashes(items.size());
+		std::vector<int> indices(items.size());
+		for (int c = 0; c < int(items.size()); c++) {
+			hashes[c] = hasher(items[c].first);
+			indices[c] = index(hashes[c]);
 		}
 
-		++count;
-		element_iterator element = bucket->insert(bucket->end(), std::make_pair(key, value));
-		return iterator(table, bucket, element);
+		for (int c = 0; c < int(items.size()); c++) {
+			prefetchBuckets(indices, c);
+			insertHashed(items[c].first, items[c].second, hashes[c], indices[c]);
+		}
 	}
 
 	/// Get value reference to an element with given key,
-	/// if key is not in the table, default construct the value and insert it
+	/// if key is not in the table, default construct the value and insert it, looks up the key only once
 	reference operator[](const K &key) {
-		iterator it = find(key);
-		if (it == end()) {
-			return insert(key, T())->second;
-		} else {
-			return it->second;
-		}
+		return tryEmplace(key).first->second;
+	}
+
+	reference operator[](K &&key) {
+		return tryEmplace(std::move(key)).first->second;
 	}
 
 	/// Erase the element pointed by the iterator and return iterator to the next element
@@ -222,6 +456,7 @@ public:
 		}
 
 		--count;
+		HASH_TABLE_COUNT(++counters.erases);
 		it.element = it.bucket->erase(it.element);
 		it.findNextValid();
 		return it;
@@ -237,4 +472,164 @@ public:
 	int size() const {
 		return count;
 	}
+
+	/// Get the number of buckets, always power of 2
+	int bucket_count() const {
+		return int(table.size());
+	}
+
+	/// Get the load factor above which the table grows
+	float max_load_factor() const {
+		return maxLoad;
+	}
+
+	/// Set the load factor above which the table grows, if the table is already above it, it grows right away
+	void max_load_factor(float factor) {
+		assert(factor > 0);
+		maxLoad = factor;
+		reserve(count);
+	}
+
+	/// Make room for n elements, so inserting up to n elements in total does not resize the table
+	/// Always re-hashes in one go, also finishes any pending incremental migration when it grows
+	void reserve(long long n) {
+		const int needed = bitsFor(n);
+		if (needed > bits) {
+			rehashTo(needed, false);
+		}
+	}
+
+	/// Re-hash to at least buckets buckets (rounded up to power of 2) and enough for size() elements, can also shrink
+	void rehash(int buckets) {
+		int newBits = bitsFor(count);
+		while ((1ll << newBits) < buckets) {
+			++newBits;
+		}
+		rehashTo(newBits, false);
+	}
+
+	/// Shrink the table to the smallest size that holds the current elements below the max load factor
+	void shrink_to_fit() {
+		rehash(0);
+	}
+
+	/// Get probe histogram and chain lengths by walking the table, and the operation counters if compiled with HASH_TABLE_STATS
+	/// Elements of buckets not yet migrated by incremental resize are included at their position in the old bucket
+	HashTableStats stats() const {
+		HashTableStats result;
+		result.size = count;
+		result.buckets = int(table.size());
+		for (const table_type *source : {&table, &oldTable}) {
+			for (int c = (source == &oldTable ? migrated : 0); c < int(source->size()); c++) {
+				for (int r = 0; r < int((*source)[c].size()); r++) {
+					result.addProbe(r + 1);
+				}
+			}
+		}
+#ifdef HASH_TABLE_STATS
+		result.counted = true;
+		result.counters = counters;
+#endif
+		return result;
+	}
+
+private:
+	/// Prefetch the buckets for the key batchPrefetchDistance ahead of idx, the bucket array is
+	/// prefetched twice as far ahead so the element array pointer is already in cache when it is needed
+	void prefetchBuckets(const std::vector<int> &indices, int idx) {
+		const int far = idx + batchPrefetchDistance * 2;
+		if (far < int(indices.size())) {
+			prefetch(&table[indices[far]]);
+		}
+		const int near = idx + batchPrefetchDistance;
+		if (near < int(indices.size())) {
+			prefetch(table[indices[near]].data());
+		}
+	}
+
+	/// Resize if needed and insert or overwrite, KeyArg and ValueArg are K and T references
+	template <typename KeyArg, typename ValueArg>
+	iterator insertOrAssign(KeyArg &&key, ValueArg &&value) {
+		HASH_TABLE_COUNT(++counters.inserts);
+		// do check before inserting as it can invalidate iterators!
+		if (shouldResize()) {
+			resize();
+		}
+		migrate();
+		const size_t hash = hasher(key);
+		return insertHashed(std::forward<KeyArg>(key), std::forward<ValueArg>(value), hash, index(hash));
+	}
+
+	/// Resize if needed and insert value constructed from args only if key is missing
+	template <typename KeyArg, typename... Args>
+	std::pair<iterator, bool> tryEmplace(KeyArg &&key, Args &&...args) {
+		HASH_TABLE_COUNT(++counters.inserts);
+		if (shouldResize()) {
+			resize();
+		}
+		migrate();
+		const size_t hash = hasher(key);
+		const int bucketIndex = index(hash);
+		iterator it = findHashed(key, hash, bucketIndex);
+		if (it != end()) {
+			return std::make_pair(it, false);
+		}
+		return std::make_pair(append(std::forward<KeyArg>(key), hash, bucketIndex, std::forward<Args>(args)...), true);
+	}
+
+	/// Insert key with known hash and bucket index, table must already be resized if needed
+	template <typename KeyArg, typename ValueArg>
+	iterator insertHashed(KeyArg &&key, ValueArg &&value, size_t hash, int bucketIndex) {
+		iterator it = findHashed(key, hash, bucketIndex);
+		// if key matches overwrite the value, it could also be in a bucket that is not yet migrated
+		if (it != end()) {
+			it->second = std::forward<ValueArg>(value);
+			return it;
+		}
+		return append(std::forward<KeyArg>(key), hash, bucketIndex, std::forward<ValueArg>(value));
+	}
+
+	/// Add element for a key known to be missing, new elements always go in the current table
+	template <typename KeyArg, typename... Args>
+	iterator append(KeyArg &&key, size_t hash, int bucketIndex, Args &&...args) {
+		bucket_iterator bucket = table.begin() + bucketIndex;
+		++count;
+		bucket->emplace_back(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		return iterator(table, nullptr, bucket, bucket->end() - 1);
+	}
+
+#ifdef HASH_TABLE_STATS
+	/// Count one lookup by key
+	void countFind(const iterator &it) {
+		++counters.finds;
+		counters.findHits += it != end();
+	}
+
+	/// Count the elements compared with the key in bucket
+	void countProbes(bucket_iterator bucket, element_iterator elIter) {
+		counters.probes += (elIter - bucket->begin()) + (elIter != bucket->end());
+	}
+#endif
+
+	/// Find implementation for both K and transparent key types with known hash and bucket index
+	template <typename Key>
+	iterator findHashed(const Key &key, size_t hash, int bucketIndex) {
+		bucket_iterator bucket = table.begin() + bucketIndex;
+		element_iterator elIter = findInBucket(bucket, key, hash);
+		HASH_TABLE_COUNT(countProbes(bucket, elIter));
+		if (elIter != bucket->end()) {
+			return iterator(table, nullptr, bucket, elIter);
+		}
+
+		// key could also be in a bucket that is not yet migrated
+		bucket = getOldBucket(hash);
+		if (bucket != oldTable.end()) {
+			elIter = findInBucket(bucket, key, hash);
+			HASH_TABLE_COUNT(countProbes(bucket, elIter));
+			if (elIter != bucket->end()) {
+				return iterator(oldTable, &table, bucket, elIter);
+			}
+		}
+		return end();
+	}
 };
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "co-hash-table.hpp"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+
+
+/// Thread safe hash table, templated by key, value and hash of key
+/// Keys are split between shards, each shard is a COHashTable guarded by its own reader/writer lock,
+/// so operations on different shards never wait for each other and lookups in one shard run in parallel.
+/// Values are returned by copy or through locked_reference, since a plain reference would outlive the lock.
+template <typename K, typename T, typename Hash = std::hash<K>>
+class ConcurrentHashTable {
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef T value_type;
+	typedef K key_type;
+private:
+	typedef std::shared_mutex lock_type;
+
+	/// Aligned to cache line so locking one shard does not invalidate the line of its neighbours
+	struct alignas(64) Shard {
+		lock_type lock; ///< Shared for lookups, exclusive for modifications
+		COHashTable<K, T, Hash> table; ///< The elements of this shard, never uses incremental resize, find must not modify it
+
+		Shard(const Hash &hasher): table(hasher) {}
+	};
+
+	std::vector<std::unique_ptr<Shard>> shards; ///< Pointers since shards can't be moved
+	int shardBits; ///< log2 of the number of shards
+	Hash hasher; ///< Hasher object
+
+	/// Get the shard for a key, selected by the high bits of a differently mixed hash
+	/// the table in the shard takes the high bits of hash * 0x9E3779B97F4A7C15 (fibonacciIndex),
+	/// using the same bits here would leave most buckets of each shard unused
+	Shard &getShard(const K &key) {
+		if (!shardBits) {
+			return *shards[0];
+		}
+		uint64_t hash = hasher(key);
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		return *shards[hash >> (64 - shardBits)];
+	}
+
+public:
+	/// Create table with at least shardCount shards, rounded up to power of 2
+	ConcurrentHashTable(int shardCount = 64, Hash hasher = Hash())
+		: shardBits(0)
+		, hasher(hasher) {
+		while ((1 << shardBits) < shardCount) {
+			++shardBits;
+		}
+		for (int c = 0; c < (1 << shardBits); c++) {
+			shards.emplace_back(new Shard(hasher));
+		}
+	}
+
+	/// Reference to a value that keeps its shard locked for writing while it is alive
+	class locked_reference {
+		friend class ConcurrentHashTable;
+		std::unique_lock<lock_type> lock; ///< Exclusive lock of the shard
+		T *value; ///< The referenced value
+
+		locked_reference(std::unique_lock<lock_type> &&lock, T &value)
+			: lock(std::move(lock))
+			, value(&value) {}
+	public:
+		/// Access the value, valid until the locked_reference is destroyed
+		T & get() const {
+			return *value;
+		}
+
+		operator T&() const {
+			return *value;
+		}
+
+		locked_reference & operator=(const T &newValue) {
+			*value = newValue;
+			return *this;
+		}
+	};
+
+	/// Copy the value for key into value, returns false if key is not in the table
+	bool find(const K &key, T &value) {
+		Shard &shard = getShard(key);
+		std::shared_lock<lock_type> lock(shard.lock);
+		auto it = shard.table.find(key);
+		if (it == shard.table.end()) {
+			return false;
+		}
+		value = it->second;
+		return true;
+	}
+
+	/// Check if key is in the table
+	bool contains(const K &key) {
+		Shard &shard = getShard(key);
+		std::shared_lock<lock_type> lock(shard.lock);
+		return shard.table.find(key) != shard.table.end();
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	void insert(const K &key, const T &value) {
+		Shard &shard = getShard(key);
+		std::unique_lock<lock_type> lock(shard.lock);
+		shard.table.insert(key, value);
+	}
+
+	/// Erase item by key, returns false if key was not in the table
+	bool erase(const K &key) {
+		Shard &shard = getShard(key);
+		std::unique_lock<lock_type> lock(shard.lock);
+		auto it = shard.table.find(key);
+		if (it == shard.table.end()) {
+			return false;
+		}
+		shard.table.erase(it);
+		return true;
+	}
+
+	/// Get locked reference to the value for key, if key is not in the table default construct the value
+	/// The shard of the key stays locked until the result is destroyed, don't access the table meanwhile
+	locked_reference operator[](const K &key) {
+		Shard &shard = getShard(key);
+		std::unique_lock<lock_type> lock(shard.lock);
+		T &value = shard.table[key];
+		return locked_reference(std::move(lock), value);
+	}
+
+	/// Call fn(T &) with the value for key under the shard lock, default construct the value if missing
+	template <typename Function>
+	void update(const K &key, Function fn) {
+		Shard &shard = getShard(key);
+		std::unique_lock<lock_type> lock(shard.lock);
+		fn(shard.table[key]);
+	}
+
+	/// Copy all key-value pairs, each shard is copied atomically, but the shards are locked one after another
+	/// so concurrent modifications of different shards can be partially visible
+	std::vector<pair_type> snapshot() {
+		std::vector<pair_type> result;
+		for (std::unique_ptr<Shard> &shard : shards) {
+			std::shared_lock<lock_type> lock(shard->lock);
+			result.reserve(result.size() + shard->table.size());
+			for (const auto &item : shard->table) {
+				result.push_back(item);
+			}
+		}
+		return result;
+	}
+
+	/// Get the number of key-value pairs in the table, exact only if there are no concurrent modifications
+	int size() {
+		int count = 0;
+		for (std::unique_ptr<Shard> &shard : shards) {
+			std::shared_lock<lock_type> lock(shard->lock);
+			count += shard->table.size();
+		}
+		return count;
+	}
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include "prefetch.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+
+/// Bucketized cuckoo hash table, templated by key, value and hash functor
+/// Every key has exactly two candidate buckets of 4 slots, so find checks at most 8 slots in 2 buckets.
+/// Each bucket is aligned to a cache line and starts with one tag byte per slot (0 for empty, else 8 bits of the hash),
+/// for key-value pairs up to 15 bytes the whole bucket is one cache line, so a lookup touches at most two lines.
+/// Insert into two full buckets moves a random element to its other bucket, repeating up to maxKicks times,
+/// which lets the table fill above 95% before it has to grow.
+/// The second bucket is computed from the first one and the tag only (partial-key cuckoo hashing),
+/// so moving an element does not call the hasher.
+template <typename K, typename T, typename Hash = std::hash<K>>
+class CuckooHashTable
+{
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef K key_type;
+	typedef T value_type;
+
+	typedef value_type & reference;
+private:
+	static constexpr int slotsPerBucket = 4;
+	static constexpr int maxKicks = 500; ///< Moves per insert before the table grows
+
+	struct alignas(64) Bucket {
+		uint8_t tags[slotsPerBucket] = {}; ///< 0 for empty slot, tag of the key otherwise
+		pair_type slots[slotsPerBucket]; ///< Key-value pairs, valid only where tag is not 0
+	};
+
+	std::vector<Bucket> buckets; ///< The table data, size is always power of 2
+	int count; ///< Actual number of elements
+	uint32_t kickState; ///< State of the xorshift generator picking the element to move
+	Hash hasher; ///< The hash functor
+
+	/// Get the hash for a key, mixed so both the bucket index and the tag depend on all bits
+	/// this matters for identity hashes like std::hash<int>
+	uint64_t getHash(const K &key) const {
+		uint64_t hash = uint64_t(hasher(key)) * 0x9E3779B97F4A7C15ull;
+		return hash ^ (hash >> 32);
+	}
+
+	/// The tag from the high bits of the hash, never 0 so it can't be confused with an empty slot
+	static uint8_t getTag(uint64_t hash) {
+		const uint8_t tag = uint8_t(hash >> 56);
+		return tag ? tag : 1;
+	}
+
+	/// First bucket for a hash from the low bits
+	int getIndex(uint64_t hash) const {
+		return int(hash & (buckets.size() - 1));
+	}
+
+	/// The other bucket of an element in bucket index with tag, alternate(alternate(i, t), t) == i
+	/// the offset is odd so both buckets are always different
+	int alternate(int index, uint8_t tag) const {
+		const uint32_t offset = (uint32_t(tag) * 0x5BD1E995u) | 1;
+		return int((index ^ offset) & (buckets.size() - 1));
+	}
+
+	/// Find the slot with key in bucket or -1
+	int findInBucket(int bucket, const K &key, uint8_t tag) const {
+		const Bucket &b = buckets[bucket];
+		for (int c = 0; c < slotsPerBucket; c++) {
+			if (b.tags[c] == tag && b.slots[c].first == key) {
+				return bucket * slotsPerBucket + c;
+			}
+		}
+		return -1;
+	}
+
+	/// Find the global slot index (bucket * slotsPerBucket + slot) holding the key or -1
+	int findSlot(const K &key, uint64_t hash) {
+		const uint8_t tag = getTag(hash);
+		const int first = getIndex(hash);
+		const int second = alternate(first, tag);
+		// the second bucket is on another cache line, start loading it while checking the first one
+		prefetch(&buckets[second]);
+		const int idx = findInBucket(first, key, tag);
+		return idx != -1 ? idx : findInBucket(second, key, tag);
+	}
+
+	/// Get free slot in bucket or -1 if it is full
+	int freeSlot(int bucket) const {
+		for (int c = 0; c < slotsPerBucket; c++) {
+			if (!buckets[bucket].tags[c]) {
+				return c;
+			}
+		}
+		return -1;
+	}
+
+	/// Next value of the xorshift generator
+	uint32_t nextRandom() {
+		kickState ^= kickState << 13;
+		kickState ^= kickState >> 17;
+		kickState ^= kickState << 5;
+		return kickState;
+	}
+
+	/// Place an element known to be missing, moving other elements out of the way
+	/// Returns true if the element is in the table, on false item holds some element (maybe another one)
+	/// that was evicted and is not in the table anymore
+	bool place(pair_type &item, uint8_t tag, int bucket) {
+		for (int kick = 0; kick <= maxKicks; kick++) {
+			int slot = freeSlot(bucket);
+			if (slot == -1) {
+				slot = freeSlot(alternate(bucket, tag));
+				if (slot != -1) {
+					bucket = alternate(bucket, tag);
+				}
+			}
+			if (slot != -1) {
+				buckets[bucket].tags[slot] = tag;
+				buckets[bucket].slots[slot] = std::move(item);
+				return true;
+			}
+			if (kick == maxKicks) {
+				break;
+			}
+
+			// both buckets full, swap with random element and move that one to its other bucket
+			bucket = nextRandom() & 1 ? alternate(bucket, tag) : bucket;
+			slot = nextRandom() % slotsPerBucket;
+			std::swap(tag, buckets[bucket].tags[slot]);
+			std::swap(item, buckets[bucket].slots[slot]);
+			bucket = alternate(bucket, tag);
+		}
+		return false;
+	}
+
+	/// Allocate table twice the size and re-insert all elements and the extra element
+	/// If some element still can't be placed, grow again
+	void resize(pair_type &extra) {
+		std::vector<pair_type> pending;
+		pending.push_back(std::move(extra));
+		int newSize = int(buckets.size()) * 2;
+
+		while (true) {
+			for (Bucket &b : buckets) {
+				for (int c = 0; c < slotsPerBucket; c++) {
+					if (b.tags[c]) {
+						pending.push_back(std::move(b.slots[c]));
+					}
+				}
+			}
+			// all elements are moved out, so the old table can be released before allocating the new one
+			std::vector<Bucket>().swap(buckets);
+			buckets.resize(newSize);
+
+			int placed = 0;
+			while (placed < int(pending.size())) {
+				const uint64_t hash = getHash(pending[placed].first);
+				if (!place(pending[placed], getTag(hash), getIndex(hash))) {
+					break;
+				}
+				++placed;
+			}
+			if (placed == int(pending.size())) {
+				return;
+			}
+			// pending[placed] now holds the evicted element, keep it and the ones not tried yet
+			pending.erase(pending.begin(), pending.begin() + placed);
+			newSize *= 2;
+		}
+	}
+
+public:
+	CuckooHashTable(Hash hash = Hash())
+		: buckets(8)
+		, count(0)
+		, kickState(2463534242u)
+		, hasher(hash) {}
+
+	/// Iterator over the key-value pairs in the table
+	class iterator {
+		friend class CuckooHashTable;
+		CuckooHashTable *table; ///< Pointer to the table, not reference so the class can have operator=
+		int index; ///< Global slot index, bucket * slotsPerBucket + slot
+
+		/// Construct from some table and slot index and move to the first valid element or the end() iterator
+		iterator(CuckooHashTable &table, int index)
+			: table(&table)
+			, index(index)
+		{
+			validateIterator();
+		}
+
+		/// If the current iterator points to empty slot move it forward until end() or valid slot
+		void validateIterator() {
+			const int end = int(table->buckets.size()) * slotsPerBucket;
+			while (index < end && !table->buckets[index / slotsPerBucket].tags[index % slotsPerBucket]) {
+				++index;
+			}
+		}
+	public:
+		/// Pair with const first element so key can be immutable to the user of the iterator
+		typedef std::pair<const K, T> const_pair;
+
+		/// Get reference to the key value pair
+		const_pair & operator*() {
+			// same binary layout, key must be const so callers can't break the table invariants
+			pair_type &item = table->buckets[index / slotsPerBucket].slots[index % slotsPerBucket];
+			return reinterpret_cast<const_pair &>(item);
+		}
+
+		/// Pointer to the key-value pair
+		const_pair * operator->() {
+			return &(operator*());
+		}
+
+		/// Prefix increment
+		iterator& operator++() {
+			++index;
+			validateIterator();
+			return *this;
+		}
+
+		/// Postfix increment
+		iterator operator++(int) {
+			iterator copy(*this);
+			++index;
+			validateIterator();
+			return copy;
+		}
+
+		/// Equality check, iterators must be from the same table
+		bool operator==(const iterator &other) const {
+			return table == other.table && index == other.index;
+		}
+
+		/// Opposite of operator==
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// First valid key-value pair or end() if table is empty
+	iterator begin() {
+		return iterator(*this, 0);
+	}
+
+	/// End iterator can be used only for equality checks
+	iterator end() {
+		return iterator(*this, int(buckets.size()) * slotsPerBucket);
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	/// Can move other elements, so it invalidates all iterators
+	iterator insert(const K &key, const T &value) {
+		const uint64_t hash = getHash(key);
+		int idx = findSlot(key, hash);
+		if (idx != -1) {
+			buckets[idx / slotsPerBucket].slots[idx % slotsPerBucket].second = value;
+			return iterator(*this, idx);
+		}
+
+		++count;
+		pair_type item(key, value);
+		if (!place(item, getTag(hash), getIndex(hash))) {
+			resize(item);
+		}
+		// the new element could have been moved by the kicks or the resize
+		return find(key);
+	}
+
+	/// Erase an item and return iterator to the next valid item or end()
+	iterator erase(iterator it) {
+		// check for end erase(find(somKey)) works as expected
+		if (it == end()) {
+			return it;
+		}
+		Bucket &b = buckets[it.index / slotsPerBucket];
+		const int slot = it.index % slotsPerBucket;
+		assert(b.tags[slot]);
+
+		// cuckoo probing never goes past a slot, so no tombstones are needed
+		b.tags[slot] = 0;
+		// release any resources held by the key and value
+		b.slots[slot] = pair_type();
+		--count;
+
+		it.validateIterator();
+		return it;
+	}
+
+	/// Erase element by key and return iterator to next element in map or end()
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get iterator for a given key or end() if key is not inserted
+	iterator find(const K &key) {
+		const int idx = findSlot(key, getHash(key));
+		if (idx == -1) {
+			return end();
+		}
+		return iterator(*this, idx);
+	}
+
+	/// Get reference to a based on a key, if not present insert default constructed value
+	T & operator[](const K &key) {
+		iterator element = find(key);
+		if (element != end()) {
+			return element->second;
+		}
+
+		return insert(key, T())->second;
+	}
+
+	/// Get the number of key-value pairs in the map
+	int size() const {
+		return count;
+	}
+
+	/// Get the ratio of used slots to all slots
+	float loadFactor() const {
+		return float(count) / (buckets.size() * slotsPerBucket);
+	}
+};
@@ -0,0 +1,400 @@
+#pragma once
+
+#include "hash-functions.hpp"
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+
+/// Insertion ordered hash table with compact storage, same scheme as the CPython dict:
+/// key-value pairs are appended to a dense entries vector in insertion order, and a separate open addressing
+/// index of 32 bit positions into entries is used for lookups. Only the index has empty slots (4 bytes each),
+/// so for large values this takes much less memory than a table of buckets kept below the max load factor,
+/// and iteration is a linear scan of the entries instead of a walk over all buckets.
+/// Erase leaves a hole in entries, once holes are more than the live elements the entries are compacted,
+/// so iteration never visits more than about twice the number of elements.
+/// The number of index slots is always power of 2 and the first slot is picked with fibonacciIndex
+template <typename K, typename T, typename Hash = std::hash<K>>
+class DenseHashTable
+{
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef K key_type;
+	typedef T value_type;
+
+	typedef value_type & reference;
+private:
+	struct Entry {
+		pair_type data; ///< Key value pair, must be first so iterators can cast Entry to pair
+		size_t hash; ///< Cached hasher(data.first)
+		bool erased; ///< true for holes left by erase, skipped by iterators
+
+		/// Construct the key from key and the value from valueArgs directly in place
+		template <typename KeyArg, typename... Args>
+		Entry(size_t hash, KeyArg &&key, Args &&...valueArgs)
+			: data(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)), std::forward_as_tuple(std::forward<Args>(valueArgs)...))
+			, hash(hash)
+			, erased(false) {}
+	};
+
+	typedef std::vector<Entry> entries_type;
+
+	static constexpr int minBits = 3; ///< log2 of the smallest and initial number of index slots
+	static constexpr int32_t emptySlot = -1; ///< Index slot never used, ends probing
+	static constexpr int32_t deletedSlot = -2; ///< Index slot of an erased element, probing continues past it
+
+	entries_type entries; ///< Elements and holes in insertion order
+	std::vector<int32_t> index; ///< Open addressing table of positions in entries, emptySlot or deletedSlot
+	int bits; ///< index.size() == 1 << bits
+	int count; ///< Actual number of elements, entries.size() - count is the number of holes
+	float maxLoad; ///< Index is rebuilt when the used slots (elements and holes) reach this load
+	Hash hasher; ///< The hash functor
+
+	/// Get the initial index slot for a given hash
+	int getSlot(size_t hash) const {
+		return fibonacciIndex(hash, bits);
+	}
+
+	/// Next slot for linear probing
+	int getNextSlot(int slot) const {
+		return (slot + 1) & (int(index.size()) - 1);
+	}
+
+	/// Check if there is no room for one more entry, every entry including holes uses one index slot
+	bool needsResize() const {
+		return entries.size() + 1 > index.size() * maxLoad;
+	}
+
+	/// Smallest log2 of slot count that holds n entries below the max load factor
+	int bitsFor(long long n) const {
+		int result = minBits;
+		while (double(n) > double(1ll << result) * maxLoad) {
+			++result;
+		}
+		return result;
+	}
+
+	/// Make room for one more entry, removes the holes and leaves space for half as many new elements as there are now
+	/// With many holes this keeps or even shrinks the index
+	void resize() {
+		rebuild(bitsFor(count + count / 2 + 1));
+	}
+
+	/// Remove the holes from entries keeping the order, position is moved to the first element at or after it
+	void compact(int &position) {
+		int live = 0;
+		int newPosition = -1;
+		for (int c = 0; c < int(entries.size()); c++) {
+			if (c == position) {
+				newPosition = live;
+			}
+			if (!entries[c].erased) {
+				if (live != c) {
+					entries[live] = std::move(entries[c]);
+				}
+				++live;
+			}
+		}
+		position = newPosition == -1 ? live : newPosition;
+		// pop_back instead of resize, so Entry does not need a default constructor
+		while (int(entries.size()) > live) {
+			entries.pop_back();
+		}
+	}
+
+	/// Compact the entries and fill a new index of 2^newBits slots from the cached hashes
+	void rebuild(int newBits, int &position) {
+		if (count != int(entries.size())) {
+			compact(position);
+		}
+		bits = newBits;
+		// new vector instead of assign, so a smaller index also releases memory
+		std::vector<int32_t>(size_t(1) << newBits, emptySlot).swap(index);
+		for (int c = 0; c < int(entries.size()); c++) {
+			int slot = getSlot(entries[c].hash);
+			while (index[slot] != emptySlot) {
+				slot = getNextSlot(slot);
+			}
+			index[slot] = c;
+		}
+	}
+
+	void rebuild(int newBits) {
+		int position = 0;
+		rebuild(newBits, position);
+	}
+
+	/// Find the index slot holding the position of key or the empty slot ending its probe sequence
+	template <typename Key>
+	int findSlot(const Key &key, size_t hash) const {
+		int slot = getSlot(hash);
+		while (true) {
+			const int32_t position = index[slot];
+			if (position == emptySlot) {
+				return slot;
+			}
+			if (position != deletedSlot && entries[position].hash == hash && entries[position].data.first == key) {
+				return slot;
+			}
+			slot = getNextSlot(slot);
+		}
+	}
+
+	/// Find the position of key in entries or -1
+	template <typename Key>
+	int findPosition(const Key &key) const {
+		const int32_t position = index[findSlot(key, hasher(key))];
+		return position == emptySlot ? -1 : position;
+	}
+
+public:
+	DenseHashTable(Hash hash = Hash())
+		: index(size_t(1) << minBits, emptySlot)
+		, bits(minBits)
+		, count(0)
+		, maxLoad(2.f / 3)
+		, hasher(hash) {}
+
+	/// Iterator over the key-value pairs in insertion order
+	class iterator {
+		friend class DenseHashTable;
+		DenseHashTable *table; ///< Pointer to the table, not reference so the class can have operator=
+		int position; ///< Position in entries
+
+		/// Construct from some table and position and move to the first valid element or the end() iterator
+		iterator(DenseHashTable &table, int position)
+			: table(&table)
+			, position(position)
+		{
+			validateIterator();
+		}
+
+		/// If the current iterator points to a hole move it forward until end() or valid element
+		void validateIterator() {
+			while (position < int(table->entries.size()) && table->entries[position].erased) {
+				++position;
+			}
+		}
+	public:
+		/// Pair with const first element so key can be immutable to the user of the iterator
+		typedef std::pair<const K, T> const_pair;
+
+		/// Get reference to the key value pair
+		const_pair & operator*() {
+			// same binary layout, key must be const so callers can't break the table invariants
+			return reinterpret_cast<const_pair &>(table->entries[position]);
+		}
+
+		/// Pointer to the key-value pair
+		const_pair * operator->() {
+			return &(operator*());
+		}
+
+		/// Prefix increment
+		iterator& operator++() {
+			++position;
+			validateIterator();
+			return *this;
+		}
+
+		/// Postfix increment
+		iterator operator++(int) {
+			iterator copy(*this);
+			++position;
+			validateIterator();
+			return copy;
+		}
+
+		/// Equality check, iterators must be from the same table
+		bool operator==(const iterator &other) const {
+			return table == other.table && position == other.position;
+		}
+
+		/// Opposite of operator==
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// First key-value pair in insertion order or end() if table is empty
+	iterator begin() {
+		return iterator(*this, 0);
+	}
+
+	/// End iterator can be used only for equality checks
+	iterator end() {
+		return iterator(*this, int(entries.size()));
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value and keeps its position in the order
+	iterator insert(const K &key, const T &value) {
+		return insertOrAssign(key, value);
+	}
+
+	/// Same as insert, but the key and value are moved into the table instead of copied
+	iterator insert(K &&key, T &&value) {
+		return insertOrAssign(std::move(key), std::move(value));
+	}
+
+	iterator insert(const K &key, T &&value) {
+		return insertOrAssign(key, std::move(value));
+	}
+
+	iterator insert(K &&key, const T &value) {
+		return insertOrAssign(std::move(key), value);
+	}
+
+	/// If key is missing insert it with value constructed in place from args, otherwise do nothing
+	/// Returns iterator to the element for key and true if it was inserted, args are not used if key is present
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+		return tryEmplace(key, std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(K &&key, Args &&...args) {
+		return tryEmplace(std::move(key), std::forward<Args>(args)...);
+	}
+
+	/// Construct key-value pair from args and insert it if the key is missing, the value is not overwritten
+	/// The pair is constructed before the lookup, prefer try_emplace when the key is available
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args &&...args) {
+		pair_type item(std::forward<Args>(args)...);
+		return tryEmplace(std::move(item.first), std::move(item.second));
+	}
+
+	/// Erase an item and return iterator to the next valid item or end()
+	/// Can compact the entries, so it invalidates all other iterators
+	iterator erase(iterator it) {
+		// check for end erase(find(somKey)) works as expected
+		if (it == end()) {
+			return it;
+		}
+		Entry &entry = entries[it.position];
+		assert(!entry.erased);
+		index[findSlot(entry.data.first, entry.hash)] = deletedSlot;
+		entry.erased = true;
+		// release any resources held by the key and value
+		entry.data = pair_type();
+		--count;
+
+		int position = it.position;
+		if (int(entries.size()) - count > count) {
+			// more holes than elements, drop them so iteration stays proportional to size()
+			rebuild(bitsFor(count + count / 2 + 1), position);
+		}
+		return iterator(*this, position);
+	}
+
+	/// Erase element by key and return iterator to next element in map or end()
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get iterator for a given key or end() if key is not inserted
+	iterator find(const K &key) {
+		const int position = findPosition(key);
+		return position == -1 ? end() : iterator(*this, position);
+	}
+
+	/// Find an element by any key type that can be hashed and compared with K, only for transparent Hash
+	/// e.g. std::string_view or const char * with StringHash, does not construct K
+	template <typename Key, typename H = Hash, typename = typename H::is_transparent>
+	iterator find(const Key &key) {
+		const int position = findPosition(key);
+		return position == -1 ? end() : iterator(*this, position);
+	}
+
+	/// Get reference to a based on a key, if not present insert default constructed value
+	/// Probes the index only once
+	T & operator[](const K &key) {
+		return tryEmplace(key).first->second;
+	}
+
+	T & operator[](K &&key) {
+		return tryEmplace(std::move(key)).first->second;
+	}
+
+	/// Get the number of key-value pairs in the map
+	int size() const {
+		return count;
+	}
+
+	/// Get the number of index slots, always power of 2
+	int bucket_count() const {
+		return int(index.size());
+	}
+
+	/// Get the load factor at which the index is rebuilt
+	float max_load_factor() const {
+		return maxLoad;
+	}
+
+	/// Set the load factor at which the index is rebuilt, must be in (0, 1) since probing needs an empty slot
+	void max_load_factor(float factor) {
+		assert(factor > 0 && factor < 1);
+		maxLoad = factor;
+		reserve(count);
+	}
+
+	/// Make room for n elements, so inserting up to n elements in total without erasing does not rebuild the index
+	void reserve(long long n) {
+		const int needed = bitsFor(n);
+		if (needed > bits) {
+			rebuild(needed);
+		}
+		entries.reserve(size_t(n));
+	}
+
+	/// Remove the holes and shrink the index and the entries to the smallest size that holds the current elements
+	void shrink_to_fit() {
+		rebuild(bitsFor(count));
+		entries.shrink_to_fit();
+	}
+
+	/// Remove all elements
+	void clear() {
+		entries_type().swap(entries);
+		index.assign(size_t(1) << minBits, emptySlot);
+		bits = minBits;
+		count = 0;
+	}
+
+private:
+	/// Insert or overwrite, KeyArg and ValueArg are K and T references
+	template <typename KeyArg, typename ValueArg>
+	iterator insertOrAssign(KeyArg &&key, ValueArg &&value) {
+		std::pair<iterator, bool> result = tryEmplace(std::forward<KeyArg>(key), std::forward<ValueArg>(value));
+		if (!result.second) {
+			result.first->second = std::forward<ValueArg>(value);
+		}
+		return result.first;
+	}
+
+	/// Append value constructed from args only if key is missing
+	/// The index may be rebuilt before the lookup, so the slot found stays valid for the append
+	template <typename KeyArg, typename... Args>
+	std::pair<iterator, bool> tryEmplace(KeyArg &&key, Args &&...args) {
+		if (needsResize()) {
+			resize();
+		}
+
+		const size_t hash = hasher(key);
+		const int slot = findSlot(key, hash);
+		if (index[slot] != emptySlot) {
+			return std::make_pair(iterator(*this, index[slot]), false);
+		}
+		// the key is missing, so the first deleted slot on its sequence could be re-used,
+		// but the empty slot is already known and the next rebuild drops the deleted ones
+		index[slot] = int32_t(entries.size());
+		entries.emplace_back(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		++count;
+		return std::make_pair(iterator(*this, index[slot]), true);
+	}
+};
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GROUP_HASH_TABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// Values of the control bytes, full slots keep the low 7 bits of the hash so their high bit is always 0
+namespace GroupControl {
+	const int8_t empty = -128; ///< 0b10000000 - never used slot, stops the probing
+	const int8_t deleted = -2; ///< 0b11111110 - removed element, can be re-used by insert
+	const int groupSize = 16; ///< Number of control bytes checked with one probe
+
+	/// Index of the lowest set bit, mask must not be 0
+	inline int lowestBit(unsigned mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/// View over groupSize consecutive control bytes, each match returns bit mask with one bit per slot
+	struct Group {
+#ifdef GROUP_HASH_TABLE_SSE2
+		__m128i ctrl;
+
+		explicit Group(const int8_t *pos)
+			: ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+		/// Slots that are full and their tag is equal to h2
+		unsigned match(int8_t h2) const {
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+		}
+
+		/// Slots that were never used
+		unsigned matchEmpty() const {
+			return match(empty);
+		}
+
+		/// Slots that are either empty or deleted - both have their high bit set
+		unsigned matchFree() const {
+			return _mm_movemask_epi8(ctrl);
+		}
+#else
+		const int8_t *ctrl;
+
+		explicit Group(const int8_t *pos): ctrl(pos) {}
+
+		unsigned match(int8_t h2) const {
+			unsigned mask = 0;
+			for (int c = 0; c < groupSize; c++) {
+				mask |= unsigned(ctrl[c] == h2) << c;
+			}
+			return mask;
+		}
+
+		unsigned matchEmpty() const {
+			return match(empty);
+		}
+
+		unsigned matchFree() const {
+			unsigned mask = 0;
+			for (int c = 0; c < groupSize; c++) {
+				mask |= unsigned(ctrl[c] < 0) << c;
+			}
+			return mask;
+		}
+#endif
+	};
+}
+
+
+/// Open addressing hash table, templated by key, value and hash functor
+/// Keeps one control byte per slot in a separate array (empty, deleted or 7 bits of the hash),
+/// probing checks a whole group of 16 control bytes at once and compares keys only on a tag match
+/// It is a separate class and not an IndexProbe of OOHashTable, since IndexProbe only picks the next bucket index
+/// and OOHashTable keeps the empty and deleted flags inside each bucket, while here probing needs the control array.
+template <typename K, typename T, typename Hash = std::hash<K>>
+class GroupHashTable
+{
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef K key_type;
+	typedef T value_type;
+
+	typedef value_type & reference;
+private:
+	typedef std::vector<pair_type> slots_t;
+	typedef typename slots_t::iterator slot_iterator;
+
+	std::vector<int8_t> control; ///< One control byte per slot
+	slots_t slots; ///< The key-value pairs, valid only where control is full
+	int count; ///< Actual number of elements
+	int tombstones; ///< Number of deleted control bytes
+	Hash hasher; ///< The hash functor
+
+	/// Get the hash for a key, mixed so both the group index and the tag depend on all bits
+	/// this matters for identity hashes like std::hash<int>
+	uint64_t getHash(const K &key) const {
+		uint64_t hash = uint64_t(hasher(key)) * 0x9E3779B97F4A7C15ull;
+		return hash ^ (hash >> 32);
+	}
+
+	/// The 7 bit tag stored in the control byte
+	static int8_t getTag(uint64_t hash) {
+		return int8_t(hash & 0x7F);
+	}
+
+	/// Number of groups, always power of 2
+	int groupCount() const {
+		return int(slots.size()) / GroupControl::groupSize;
+	}
+
+	/// Get the first group index for a given hash
+	int getGroup(uint64_t hash) const {
+		return int((hash >> 7) & (groupCount() - 1));
+	}
+
+	/// Triangular probing over the groups, visits each group once when group count is power of 2
+	int getNextGroup(int group, int step) const {
+		return (group + step) & (groupCount() - 1);
+	}
+
+	/// Check if the table needs to be resized, deleted slots also count since they make probing longer
+	bool needsResize() const {
+		const float factor = float(count + tombstones) / slots.size();
+		return factor >= 0.8;
+	}
+
+	/// Find the slot holding the key or -1 if the key is not in the table
+	int findSlot(const K &key, uint64_t hash) const {
+		const int8_t tag = getTag(hash);
+		int group = getGroup(hash);
+
+		for (int step = 1; step <= groupCount(); step++) {
+			const int base = group * GroupControl::groupSize;
+			const GroupControl::Group probe(control.data() + base);
+
+			for (unsigned mask = probe.match(tag); mask; mask &= mask - 1) {
+				const int idx = base + GroupControl::lowestBit(mask);
+				if (slots[idx].first == key) {
+					return idx;
+				}
+			}
+
+			// an empty slot means the key would have been inserted in this group
+			if (probe.matchEmpty()) {
+				return -1;
+			}
+			group = getNextGroup(group, step);
+		}
+		return -1;
+	}
+
+	/// Find the first empty or deleted slot for a given hash, there is always one since load is capped
+	int findFreeSlot(uint64_t hash) const {
+		int group = getGroup(hash);
+
+		for (int step = 1; ; step++) {
+			const int base = group * GroupControl::groupSize;
+			const unsigned mask = GroupControl::Group(control.data() + base).matchFree();
+			if (mask) {
+				return base + GroupControl::lowestBit(mask);
+			}
+			group = getNextGroup(group, step);
+		}
+	}
+
+	/// Resize and re-hash the table, if mostly tombstones are present re-hash with the same size
+	void resize() {
+		const int newSize = count * 2 < int(slots.size()) ? int(slots.size()) : int(slots.size()) * 2;
+
+		std::vector<int8_t> oldControl(newSize, GroupControl::empty);
+		slots_t oldSlots(newSize);
+		// swap with members so we can re-use findFreeSlot
+		oldControl.swap(control);
+		oldSlots.swap(slots);
+		tombstones = 0;
+
+		for (int c = 0; c < int(oldSlots.size()); c++) {
+			if (oldControl[c] >= 0) {
+				// all keys are unique, directly place them in first free slot
+				const uint64_t hash = getHash(oldSlots[c].first);
+				const int idx = findFreeSlot(hash);
+				control[idx] = getTag(hash);
+				slots[idx] = std::move(oldSlots[c]);
+			}
+		}
+	}
+
+public:
+	GroupHashTable(Hash hash = Hash())
+		: control(32, GroupControl::empty)
+		, slots(32)
+		, count(0)
+		, tombstones(0)
+		, hasher(hash) {}
+
+	/// Iterator over the key-value pairs in the table
+	class iterator {
+		friend class GroupHashTable;
+		GroupHashTable *table; ///< Pointer to the table, not reference so the class can have operator=
+		int index; ///< Index of the slot
+
+		/// Construct from some table and slot index and move to the first valid element or the end() iterator
+		iterator(GroupHashTable &table, int index)
+			: table(&table)
+			, index(index)
+		{
+			validateIterator();
+		}
+
+		/// If the current iterator points to empty or deleted slot move it forward until end() or valid slot
+		void validateIterator() {
+			while (index < int(table->slots.size()) && table->control[index] < 0) {
+				++index;
+			}
+		}
+	public:
+		/// Pair with const first element so key can be immutable to the user of the iterator
+		typedef std::pair<const K, T> const_pair;
+
+		/// Get reference to the key value pair
+		const_pair & operator*() {
+			// same binary layout, key must be const so callers can't break the table invariants
+			return reinterpret_cast<const_pair &>(table->slots[index]);
+		}
+
+		/// Pointer to the key-value pair
+		const_pair * operator->() {
+			return &(operator*());
+		}
+
+		/// Prefix increment
+		iterator& operator++() {
+			++index;
+			validateIterator();
+			return *this;
+		}
+
+		/// Postfix increment
+		iterator operator++(int) {
+			iterator copy(*this);
+			++index;
+			validateIterator();
+			return copy;
+		}
+
+		/// Equality check, iterators must be from the same table
+		bool operator==(const iterator &other) const {
+			return table == other.table && index == other.index;
+		}
+
+		/// Opposite of operator==
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// First valid key-value pair or end() if table is empty
+	iterator begin() {
+		return iterator(*this, 0);
+	}
+
+	/// End iterator can be used only for equality checks
+	iterator end() {
+		return iterator(*this, int(slots.size()));
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	iterator insert(const K &key, const T &value) {
+		if (needsResize()) {
+			resize();
+		}
+
+		const uint64_t hash = getHash(key);
+		int idx = findSlot(key, hash);
+		if (idx != -1) {
+			slots[idx].second = value;
+			return iterator(*this, idx);
+		}
+
+		idx = findFreeSlot(hash);
+		if (control[idx] == GroupControl::deleted) {
+			--tombstones;
+		}
+		++count;
+		control[idx] = getTag(hash);
+		slots[idx] = std::make_pair(key, value);
+
+		return iterator(*this, idx);
+	}
+
+	/// Erase an item and return iterator to the next valid item or end()
+	iterator erase(iterator it) {
+		// check for end erase(find(somKey)) works as expected
+		if (it == end()) {
+			return it;
+		}
+		assert(control[it.index] >= 0);
+
+		// if the group still has an empty slot it was never full, so no probe sequence
+		// went past it and the slot can be marked empty instead of deleted
+		const int base = it.index & ~(GroupControl::groupSize - 1);
+		if (GroupControl::Group(control.data() + base).matchEmpty()) {
+			control[it.index] = GroupControl::empty;
+		} else {
+			control[it.index] = GroupControl::deleted;
+			++tombstones;
+		}
+		// release any resources held by the key and value
+		slots[it.index] = pair_type();
+		--count;
+
+		it.validateIterator();
+		return it;
+	}
+
+	/// Erase element by key and return iterator to next element in map or end()
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get iterator for a given key or end() if key is not inserted
+	iterator find(const K &key) {
+		const int idx = findSlot(key, getHash(key));
+		if (idx == -1) {
+			return end();
+		}
+		return iterator(*this, idx);
+	}
+
+	/// Get reference to a based on a key, if not present insert default constructed value
+	T & operator[](const K &key) {
+		iterator element = find(key);
+		if (element != end()) {
+			return element->second;
+		}
+
+		return insert(key, T())->second;
+	}
+
+	/// Get the number of key-value pairs in the map
+	int size() const {
+		return count;
+	}
+};
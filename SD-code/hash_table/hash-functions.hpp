@@ -0,0 +1,231 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+
+/// Hash for std::string keys that also accepts std::string_view and const char *
+/// Marked as transparent, so tables using it can find keys without constructing a std::string
+/// Gives the same values as std::hash<std::string>
+struct StringHash {
+	typedef void is_transparent;
+
+	size_t operator()(std::string_view key) const {
+		return std::hash<std::string_view>()(key);
+	}
+};
+
+
+/// Map hash to a bucket index in [0, 2^bits) with fibonacci hashing: multiply by 2^64 / golden ratio and keep the top bits
+/// Cheaper than % table.size() and the result depends on all bits of the hash, so identity hashes like
+/// std::hash<int> of sequential keys are spread over the table instead of filling one run of buckets
+/// bits must be in [1, 63]
+inline int fibonacciIndex(size_t hash, int bits) {
+	return int((uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+
+/// Multiply-xorshift mixer for integer keys, each output bit depends on all input bits
+/// std::hash of integers is the identity on libstdc++, so sequential keys give sequential hashes,
+/// this matters for tables that don't mix the hash themselves and for the tag bits taken from the hash
+struct IntMixHash {
+	template <typename Int>
+	size_t operator()(Int key) const {
+		static_assert(std::is_integral<Int>::value, "IntMixHash is only for integer keys");
+		uint64_t hash = uint64_t(key);
+		hash ^= hash >> 32;
+		hash *= 0xD6E8FEB86659FD93ull;
+		hash ^= hash >> 32;
+		hash *= 0xD6E8FEB86659FD93ull;
+		hash ^= hash >> 32;
+		return size_t(hash);
+	}
+};
+
+
+namespace HashDetail {
+	const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+	/// Keys xor-ed in the data before multiplying, so zero bytes don't zero the products
+	const uint64_t secret[4] = {0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull};
+
+	inline uint64_t read64(const unsigned char *data) {
+		uint64_t result;
+		memcpy(&result, data, sizeof(result));
+		return result;
+	}
+
+	inline uint32_t read32(const unsigned char *data) {
+		uint32_t result;
+		memcpy(&result, data, sizeof(result));
+		return result;
+	}
+
+	inline uint64_t rotl(uint64_t value, int shift) {
+		return (value << shift) | (value >> (64 - shift));
+	}
+
+	/// Final avalanche, same as the murmur3 finalizer
+	inline uint64_t avalanche(uint64_t hash) {
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	/// Two 64 bit lanes of accumulator, one 16 byte block is mixed into both lanes at once
+	/// Each lane adds the data of the other lane and the product of the low and high 32 bits of its data ^ secret,
+	/// the SSE2 version (pmuludq) and the scalar one give the same results
+#if defined(__SSE2__) || defined(_M_X64)
+	struct Accumulator {
+		__m128i acc;
+
+		explicit Accumulator(uint64_t seed): acc(_mm_set_epi64x(int64_t(seed ^ prime2), int64_t(seed ^ prime1))) {}
+
+		void add(const unsigned char *block, __m128i key) {
+			const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+			const __m128i keyed = _mm_xor_si128(data, key);
+			// [lo0, hi0, lo1, hi1] -> [hi0, lo0, hi1, lo1], so pmuludq multiplies lo * hi in each lane
+			const __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(2, 3, 0, 1)));
+			const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			acc = _mm_add_epi64(acc, _mm_add_epi64(product, swapped));
+		}
+
+		static __m128i key(int index) {
+			return _mm_set_epi64x(int64_t(secret[index + 1]), int64_t(secret[index]));
+		}
+
+		uint64_t lane(int index) const {
+			uint64_t lanes[2];
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+			return lanes[index];
+		}
+	};
+#else
+	struct Accumulator {
+		uint64_t acc[2];
+
+		explicit Accumulator(uint64_t seed): acc{seed ^ prime1, seed ^ prime2} {}
+
+		struct Key {
+			uint64_t lanes[2];
+		};
+
+		void add(const unsigned char *block, Key key) {
+			const uint64_t data[2] = {read64(block), read64(block + 8)};
+			for (int c = 0; c < 2; c++) {
+				const uint64_t keyed = data[c] ^ key.lanes[c];
+				acc[c] += (keyed & 0xFFFFFFFFull) * (keyed >> 32) + data[c ^ 1];
+			}
+		}
+
+		static Key key(int index) {
+			return Key{{secret[index], secret[index + 1]}};
+		}
+
+		uint64_t lane(int index) const {
+			return acc[index];
+		}
+	};
+#endif
+}
+
+
+/// Hash any byte range, 16 byte blocks are mixed with SSE2 when available, two blocks per step in independent accumulators
+/// Keys up to 16 bytes are read with at most two overlapping loads, longer ones also mix the last 16 bytes
+/// The result does not depend on the instruction set, but it does on the byte order of the machine
+inline size_t hashBytes(const void *bytes, size_t length, uint64_t seed = 0) {
+	using namespace HashDetail;
+	const unsigned char *data = static_cast<const unsigned char *>(bytes);
+	if (length <= 16) {
+		uint64_t low = 0, high = 0;
+		if (length >= 8) {
+			low = read64(data);
+			high = read64(data + length - 8);
+		} else if (length >= 4) {
+			low = read32(data);
+			high = read32(data + length - 4);
+		} else if (length > 0) {
+			low = uint64_t(data[0]) | uint64_t(data[length / 2]) << 8 | uint64_t(data[length - 1]) << 16;
+		}
+		const uint64_t hash = (low ^ secret[0] ^ seed) * prime1 + rotl((high ^ secret[1]) * prime2, 31);
+		return size_t(avalanche(hash ^ length));
+	}
+
+	Accumulator first(seed), second(seed ^ secret[3]);
+	size_t offset = 0;
+	for (; offset + 32 <= length; offset += 32) {
+		first.add(data + offset, Accumulator::key(0));
+		second.add(data + offset + 16, Accumulator::key(2));
+	}
+	if (offset + 16 <= length) {
+		first.add(data + offset, Accumulator::key(2));
+	}
+	// the last block can overlap bytes already mixed, the length in the final mix keeps keys of different lengths apart
+	second.add(data + length - 16, Accumulator::key(1));
+
+	uint64_t hash = length * prime1;
+	hash += (first.lane(0) ^ second.lane(1)) * prime2;
+	hash ^= rotl(first.lane(1) + second.lane(0), 29) * prime1;
+	return size_t(avalanche(hash));
+}
+
+
+/// Hash for std::string keys built on hashBytes, transparent like StringHash
+/// Much faster than std::hash<std::string> for long keys, about the same for short ones
+struct FastStringHash {
+	typedef void is_transparent;
+
+	size_t operator()(std::string_view key) const {
+		return hashBytes(key.data(), key.size());
+	}
+};
+
+
+#ifdef __SSE4_2__
+/// Hash using the CRC32C instruction of SSE 4.2, only defined when compiling for it (e.g. -msse4.2 or -march=native)
+/// The CRC has only 32 bits, so it is spread to 64 bits with a multiplication,
+/// enough for tables that pick the bucket from the top bits, like fibonacciIndex does
+/// Accepts integer keys and anything convertible to std::string_view
+struct Crc32cHash {
+	typedef void is_transparent;
+
+	template <typename Int, typename = typename std::enable_if<std::is_integral<Int>::value>::type>
+	size_t operator()(Int key) const {
+		return spread(_mm_crc32_u64(0, uint64_t(key)));
+	}
+
+	size_t operator()(std::string_view key) const {
+		const unsigned char *data = reinterpret_cast<const unsigned char *>(key.data());
+		const size_t length = key.size();
+		uint64_t crc = ~0ull;
+		size_t offset = 0;
+		for (; offset + 8 <= length; offset += 8) {
+			crc = _mm_crc32_u64(crc, HashDetail::read64(data + offset));
+		}
+		for (; offset < length; offset++) {
+			crc = _mm_crc32_u8(uint32_t(crc), data[offset]);
+		}
+		return spread(crc ^ length);
+	}
+
+private:
+	static size_t spread(uint64_t crc) {
+		return size_t((crc ^ (crc << 32)) * 0x9E3779B97F4A7C15ull);
+	}
+};
+#endif
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "oo-hash-table.hpp"
+#include "parallel-for.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+
+/// Which probe rows are reported by HashJoin::probe
+enum class JoinType {
+	inner, ///< Only probe rows with at least one matching build row, once per match
+	leftOuter, ///< Same as inner, plus one row with no match for every probe row that has no build row
+};
+
+
+/// Hash join of a build side of (key, T) rows with probe side streams of (key, U) rows, duplicate keys are allowed on both sides
+/// Both sides are radix partitioned on the hash, the number of partitions is picked so the table of one build partition fits in
+/// cacheBytes (meant to be the L2 size), so the lookups of a partition hit the cache instead of the memory.
+/// Partitioning, building the per partition OOHashTable and probing run on up to threads threads, each one takes a range of partitions.
+/// The table of a partition maps a key to its last build row, the other rows with the same key are chained with next
+template <typename K, typename T, typename Hash = std::hash<K>>
+class HashJoin {
+public:
+	typedef std::pair<K, T> build_row;
+private:
+	typedef OOHashTable<K, int, Hash> table_type;
+
+	std::vector<build_row> rows; ///< Build rows ordered by partition
+	std::vector<int> next; ///< next[i] is the previous build row with the same key as rows[i] or -1
+	std::vector<int> offsets; ///< Rows of partition p are [offsets[p], offsets[p + 1])
+	std::vector<table_type> tables; ///< Key to last row index, one table per partition
+	int partitionBits; ///< log2 of the number of partitions
+	int threads; ///< Threads used for all phases
+	size_t cacheBytes; ///< Memory a partition table should fit in
+	Hash hasher; ///< The hash functor
+
+	/// Partition for a hash, from a different multiplier than fibonacciIndex used by the tables,
+	/// otherwise all keys of a partition would share the top bits of their bucket index and use a fraction of the buckets
+	int partitionOf(size_t hash) const {
+		return partitionBits ? int((uint64_t(hash) * 0xD6E8FEB86659FD93ull) >> (64 - partitionBits)) : 0;
+	}
+
+	/// Estimated bytes per build row: the row itself, next and the table bucket at about half load
+	static size_t bytesPerRow() {
+		return sizeof(build_row) + sizeof(int) + 2 * (sizeof(std::pair<K, int>) + sizeof(size_t) + 2);
+	}
+
+	/// Copy source to result ordered by partition, partitionStart gets the first index of each partition and the total at the end
+	/// Each thread counts the partitions of its range of rows, then copies them to its own slice of every partition, so the order
+	/// of the rows inside a partition is the same as in source
+	template <typename Row>
+	void partition(const std::vector<Row> &source, std::vector<Row> &result, std::vector<int> &partitionStart) const {
+		const int partitions = 1 << partitionBits;
+		const int chunks = std::max(1, std::min(threads, int(source.size())));
+		const int chunkSize = (int(source.size()) + chunks - 1) / chunks;
+		// histograms[chunk][partition], then reused as the write position of that chunk in that partition
+		std::vector<std::vector<int>> histograms(chunks, std::vector<int>(partitions, 0));
+		// partitionBits is at most 16, so the partition of each row fits in 16 bits
+		std::vector<uint16_t> partitionOfRow(source.size());
+
+		parallelRanges(chunks, chunks, 1, [&](int fromChunk, int toChunk) {
+			for (int chunk = fromChunk; chunk < toChunk; chunk++) {
+				const int end = std::min(int(source.size()), (chunk + 1) * chunkSize);
+				for (int c = chunk * chunkSize; c < end; c++) {
+					partitionOfRow[c] = uint16_t(partitionOf(hasher(source[c].first)));
+					++histograms[chunk][partitionOfRow[c]];
+				}
+			}
+		});
+
+		partitionStart.assign(partitions + 1, 0);
+		int position = 0;
+		for (int p = 0; p < partitions; p++) {
+			partitionStart[p] = position;
+			for (int chunk = 0; chunk < chunks; chunk++) {
+				const int size = histograms[chunk][p];
+				histograms[chunk][p] = position;
+				position += size;
+			}
+		}
+		partitionStart[partitions] = position;
+
+		result.clear();
+		result.resize(source.size());
+		parallelRanges(chunks, chunks, 1, [&](int fromChunk, int toChunk) {
+			for (int chunk = fromChunk; chunk < toChunk; chunk++) {
+				std::vector<int> &write = histograms[chunk];
+				const int end = std::min(int(source.size()), (chunk + 1) * chunkSize);
+				for (int c = chunk * chunkSize; c < end; c++) {
+					result[write[partitionOfRow[c]]++] = source[c];
+				}
+			}
+		});
+	}
+
+public:
+	/// Use up to threads threads and make the table of one partition about cacheBytes large
+	HashJoin(int threads = 1, size_t cacheBytes = 1 << 20, Hash hash = Hash())
+		: partitionBits(0)
+		, threads(std::max(1, threads))
+		, cacheBytes(cacheBytes)
+		, hasher(hash) {}
+
+	/// Partition the build rows and build the table of each partition, replaces any previous build side
+	void build(const std::vector<build_row> &buildRows) {
+		partitionBits = 0;
+		while ((size_t(buildRows.size()) >> partitionBits) * bytesPerRow() > cacheBytes && partitionBits < 16) {
+			++partitionBits;
+		}
+		partition(buildRows, rows, offsets);
+
+		const int partitions = 1 << partitionBits;
+		tables.clear();
+		tables.resize(partitions, table_type(hasher));
+		next.assign(rows.size(), -1);
+		parallelRanges(threads, partitions, 1, [this](int from, int to) {
+			for (int p = from; p < to; p++) {
+				table_type &table = tables[p];
+				table.reserve(offsets[p + 1] - offsets[p]);
+				for (int c = offsets[p]; c < offsets[p + 1]; c++) {
+					std::pair<typename table_type::iterator, bool> slot = table.try_emplace(rows[c].first, c);
+					if (!slot.second) {
+						// duplicate key, chain the older row behind the new one
+						next[c] = slot.first->second;
+						slot.first->second = c;
+					}
+				}
+			}
+		});
+	}
+
+	/// Join probeRows with the build side, emit(thread, probeRow, buildRow) is called for each result row
+	/// For JoinType::leftOuter, buildRow is nullptr for probe rows without a match
+	/// emit is called concurrently from different threads, thread is in [0, threads) and is the same for all
+	/// calls from one thread, so emit can write to per thread output without locking
+	template <typename U, typename Emit>
+	void probe(const std::vector<std::pair<K, U>> &probeRows, JoinType type, Emit emit) {
+		typedef std::pair<K, U> probe_row;
+		std::vector<probe_row> partitioned;
+		std::vector<int> probeOffsets;
+		partition(probeRows, partitioned, probeOffsets);
+
+		const int partitions = 1 << partitionBits;
+		const int workers = std::min(threads, partitions);
+		// partitions are of similar size, so a fixed split gives each thread about the same work
+		parallelRanges(workers, workers, 1, [&](int fromWorker, int toWorker) {
+			for (int worker = fromWorker; worker < toWorker; worker++) {
+				const int from = int((long long)partitions * worker / workers);
+				const int to = int((long long)partitions * (worker + 1) / workers);
+				for (int p = from; p < to; p++) {
+					table_type &table = tables[p];
+					for (int c = probeOffsets[p]; c < probeOffsets[p + 1]; c++) {
+						const probe_row &row = partitioned[c];
+						typename table_type::iterator match = table.find(row.first);
+						if (match == table.end()) {
+							if (type == JoinType::leftOuter) {
+								emit(worker, row, static_cast<const build_row *>(nullptr));
+							}
+							continue;
+						}
+						for (int idx = match->second; idx != -1; idx = next[idx]) {
+							emit(worker, row, &rows[idx]);
+						}
+					}
+				}
+			}
+		});
+	}
+
+	/// Number of partitions of the current build side
+	int partitionCount() const {
+		return 1 << partitionBits;
+	}
+
+	/// Number of rows of the current build side
+	int size() const {
+		return int(rows.size());
+	}
+};
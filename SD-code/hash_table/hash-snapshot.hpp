@@ -0,0 +1,245 @@
+#pragma once
+
+#include "hash-functions.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/// Layout of the snapshot file written by OOHashTable::save_snapshot:
+/// Header, one control byte per bucket, then one Slot per bucket starting at slotOffset
+/// All positions are offsets from the start of the file, so the image works at any mapping address
+/// Keys and values are raw bytes, so the file can be opened only on machine with the same layout and hash function
+namespace SnapshotFormat {
+	const char magic[8] = {'O', 'O', 'H', 'S', 'N', 'A', 'P', '2'};
+
+	/// Control byte values, full buckets also keep the low 7 bits of the hash so most mismatches don't touch the slot
+	const uint8_t empty = 0;
+	const uint8_t deleted = 1;
+	const uint8_t full = 0x80;
+
+	/// Slots start on a cache line
+	const uint64_t slotAlign = 64;
+
+	struct Header {
+		char magic[8]; ///< Must be SnapshotFormat::magic
+		uint32_t keySize; ///< sizeof(K) of the table that wrote the file
+		uint32_t valueSize; ///< sizeof(T) of the table that wrote the file
+		uint32_t slotSize; ///< sizeof(Slot<K, T>)
+		uint32_t bucketCount; ///< Number of buckets, power of 2, lookups start at fibonacciIndex(hash, log2(bucketCount))
+		uint64_t count; ///< Number of key-value pairs
+		uint64_t controlOffset; ///< Offset of the control bytes
+		uint64_t slotOffset; ///< Offset of the slots
+		uint64_t fileSize; ///< Total size, used to detect truncated files
+	};
+
+	/// Key-value pair as stored in the file, std::pair is not trivially copyable so it can't be used
+	template <typename K, typename T>
+	struct Slot {
+		K key;
+		T value;
+	};
+
+	/// Control byte for a full bucket with the given hash
+	inline uint8_t tag(size_t hash) {
+		return full | uint8_t(hash & 0x7f);
+	}
+}
+
+
+/// Read only mapping of a whole file, unmapped in destructor
+class MappedFile {
+	const char *data; ///< Start of the mapping or nullptr
+	size_t length; ///< Size of the mapping
+public:
+	MappedFile(): data(nullptr), length(0) {}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	MappedFile(MappedFile &&other): data(other.data), length(other.length) {
+		other.data = nullptr;
+		other.length = 0;
+	}
+
+	MappedFile & operator=(MappedFile &&other) {
+		std::swap(data, other.data);
+		std::swap(length, other.length);
+		return *this;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	/// Map path read only, returns false if the file can't be opened or is empty
+	bool open(const char *path) {
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		if (mapping) {
+			data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			length = data ? size_t(size.QuadPart) : 0;
+			// the view keeps the mapping alive
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+#else
+		const int fd = ::open(path, O_RDONLY);
+		if (fd == -1) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void *mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+			if (mapped != MAP_FAILED) {
+				data = static_cast<const char *>(mapped);
+				length = size_t(info.st_size);
+			}
+		}
+		// the mapping stays valid after the descriptor is closed
+		::close(fd);
+#endif
+		return data != nullptr;
+	}
+
+	void close() {
+		if (!data) {
+			return;
+		}
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<char *>(data), length);
+#endif
+		data = nullptr;
+		length = 0;
+	}
+
+	const char * begin() const {
+		return data;
+	}
+
+	size_t size() const {
+		return length;
+	}
+};
+
+
+/// Read only view of a snapshot written by OOHashTable::save_snapshot, answers find directly from the mapped file
+/// Nothing is read at open time except the header, pages are loaded by the OS when lookups touch them
+/// Hash and IndexProbe must be the same as the ones of the table that wrote the snapshot
+template <typename K, typename T, typename Hash, typename IndexProbe>
+class OOHashSnapshot {
+	typedef SnapshotFormat::Slot<K, T> slot_type;
+
+	MappedFile file; ///< The mapped snapshot
+	const uint8_t *control; ///< Control bytes inside the mapping
+	const slot_type *slots; ///< Slots inside the mapping
+	int bucketCount; ///< Number of buckets
+	int bucketBits; ///< log2 of bucketCount
+	int count; ///< Number of key-value pairs
+	Hash hasher; ///< Hasher object
+	IndexProbe nextIndex; ///< Functor to access next index
+
+	/// Check the header and set the pointers into the mapping, on failure leave the view closed
+	bool load() {
+		const SnapshotFormat::Header *header = reinterpret_cast<const SnapshotFormat::Header *>(file.begin());
+		const bool valid = file.size() >= sizeof(SnapshotFormat::Header)
+			&& memcmp(header->magic, SnapshotFormat::magic, sizeof(header->magic)) == 0
+			&& header->keySize == sizeof(K)
+			&& header->valueSize == sizeof(T)
+			&& header->slotSize == sizeof(slot_type)
+			&& header->bucketCount > 1
+			&& (header->bucketCount & (header->bucketCount - 1)) == 0
+			&& header->fileSize == file.size()
+			&& header->controlOffset + header->bucketCount <= header->slotOffset
+			&& header->slotOffset % alignof(slot_type) == 0
+			&& header->slotOffset + uint64_t(header->bucketCount) * sizeof(slot_type) <= file.size();
+		if (!valid) {
+			file.close();
+			return false;
+		}
+		control = reinterpret_cast<const uint8_t *>(file.begin() + header->controlOffset);
+		slots = reinterpret_cast<const slot_type *>(file.begin() + header->slotOffset);
+		bucketCount = int(header->bucketCount);
+		bucketBits = 0;
+		while ((1 << bucketBits) < bucketCount) {
+			++bucketBits;
+		}
+		count = int(header->count);
+		return true;
+	}
+public:
+	OOHashSnapshot(Hash hash = Hash(), IndexProbe probe = IndexProbe())
+		: control(nullptr)
+		, slots(nullptr)
+		, bucketCount(0)
+		, bucketBits(0)
+		, count(0)
+		, hasher(hash)
+		, nextIndex(probe) {}
+
+	/// Map the snapshot at path, returns false if it is missing or was written for different key/value types
+	bool open(const char *path) {
+		control = nullptr;
+		slots = nullptr;
+		bucketCount = count = 0;
+		return file.open(path) && load();
+	}
+
+	/// Check if a snapshot is mapped
+	bool isOpen() const {
+		return control != nullptr;
+	}
+
+	/// Get pointer to the value for key inside the mapping or nullptr if key is not in the snapshot
+	const T * find(const K &key) const {
+		if (!bucketCount) {
+			return nullptr;
+		}
+		const size_t hash = hasher(key);
+		const uint8_t tag = SnapshotFormat::tag(hash);
+		int idx = fibonacciIndex(hash, bucketBits);
+		// a table keeps empty buckets since it counts tombstones in its load, the bound only guards corrupted or hand-built images
+		for (int probe = 0; probe < bucketCount; probe++) {
+			const uint8_t current = control[idx];
+			if (current == SnapshotFormat::empty) {
+				return nullptr;
+			}
+			if (current == tag && slots[idx].key == key) {
+				return &slots[idx].value;
+			}
+			idx = nextIndex(idx, bucketCount);
+		}
+		return nullptr;
+	}
+
+	/// Get the number of key-value pairs in the snapshot
+	int size() const {
+		return count;
+	}
+};
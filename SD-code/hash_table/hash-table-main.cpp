@@ -1,9 +1,80 @@
 
 #include "oo-hash-table.hpp"
 #include "co-hash-table.hpp"
+#include "group-hash-table.hpp"
+#include "rh-hash-table.hpp"
+#include "concurrent-hash-table.hpp"
+#include "lock-free-hash-table.hpp"
+#include "slab-hash-table.hpp"
+#include "cuckoo-hash-table.hpp"
+#include "soa-hash-table.hpp"
+#include "dense-hash-table.hpp"
+#include "hash-join.hpp"
+#include "hash-functions.hpp"
 
 #include <cassert>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <atomic>
+#include <new>
+#include <memory>
+#include <cstdlib>
+#include <cstddef>
+
+/// Number of calls to the global operator new, used to measure allocations per insert
+std::atomic<long long> allocationCount(0);
+/// Bytes currently allocated with the global operator new, used to measure the memory of the tables
+std::atomic<long long> allocatedBytes(0);
+
+/// Every allocation starts with a header holding its size, so operator delete can subtract it
+/// The header is max_align_t sized so the returned pointer keeps the alignment malloc gives
+const size_t allocationHeader = alignof(std::max_align_t);
+
+void * operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (char *ptr = static_cast<char *>(malloc(allocationHeader + size))) {
+		*reinterpret_cast<size_t *>(ptr) = size;
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		return ptr + allocationHeader;
+	}
+	throw std::bad_alloc();
+}
+
+// gcc sees the free after inlining into callers of new and takes it for a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *ptr) noexcept {
+	if (!ptr) {
+		return;
+	}
+	char *start = static_cast<char *>(ptr) - allocationHeader;
+	allocatedBytes.fetch_sub(*reinterpret_cast<size_t *>(start), std::memory_order_relaxed);
+	free(start);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+/// COHashTable with incremental resize enabled, so it can be passed to testTable
+template <typename K, typename T, typename Hash = std::hash<K>>
+class IncrementalCOHashTable : public COHashTable<K, T, Hash> {
+public:
+	IncrementalCOHashTable() {
+		this->setIncrementalResize(4);
+	}
+};
 
 /// accept any container with typename templates
 /// function will work correctly only if HashTable is actually a key-value associative container
@@ -143,16 +214,1415 @@ void testTable() {
 	}
 }
 
-int main()
+/// Lookup std::string keys with std::string_view and const char * and check that no std::string is constructed
+template <template <typename ...> class HashTable>
+void testTransparentFind() {
+	HashTable<std::string, int, StringHash> ht;
+	const int count = 1000;
+	char buffer[128];
+	for (int c = 0; c < count; c++) {
+		// long enough to not fit in the small string buffer, so constructing std::string allocates
+		snprintf(buffer, sizeof(buffer), "some-long-network-buffer-key-%d", c);
+		ht.insert(buffer, c);
+	}
+
+	const long long allocations = allocationCount.load();
+	for (int c = 0; c < count; c++) {
+		snprintf(buffer, sizeof(buffer), "some-long-network-buffer-key-%d-and-more", c);
+		// view only the key part of the buffer
+		const std::string_view key(buffer, strlen(buffer) - strlen("-and-more"));
+		assert(ht.find(key) != ht.end());
+		assert(ht.find(key)->second == c);
+		assert(ht.find(std::string_view(buffer)) == ht.end());
+	}
+	assert(ht.find("some-long-network-buffer-key-0") != ht.end());
+	assert(allocationCount.load() == allocations);
+}
+
+/// Check that find_batch and insert_batch give the same results as find and insert
+template <template <typename ...> class HashTable>
+void testBatch() {
+	HashTable<int, int> ht;
+	std::vector<std::pair<int, int>> items;
+	for (int c = 0; c < 10000; c++) {
+		items.push_back(std::make_pair(c * 7, c));
+	}
+	// some keys twice, the later value wins
+	items.push_back(std::make_pair(0, -1));
+	ht.insert_batch(items);
+	assert(ht.size() == 10000);
+
+	std::vector<int> keys;
+	for (int c = 0; c < 20000; c++) {
+		keys.push_back(c * 7);
+	}
+	std::vector<typename HashTable<int, int>::iterator> result;
+	ht.find_batch(keys, result);
+	assert(result.size() == keys.size());
+	for (int c = 0; c < int(keys.size()); c++) {
+		assert(result[c] == ht.find(keys[c]));
+		if (c < 10000) {
+			assert(result[c] != ht.end() && result[c]->second == (c ? c : -1));
+		} else {
+			assert(result[c] == ht.end());
+		}
+	}
+}
+
+/// Value that counts how many times it was copied
+struct CopyCounted {
+	static int copies;
+	int value;
+
+	CopyCounted(int value = 0): value(value) {}
+	CopyCounted(const CopyCounted &other): value(other.value) { ++copies; }
+	CopyCounted(CopyCounted &&other) = default;
+	CopyCounted & operator=(const CopyCounted &other) { value = other.value; ++copies; return *this; }
+	CopyCounted & operator=(CopyCounted &&other) = default;
+};
+int CopyCounted::copies = 0;
+
+/// Check emplace, try_emplace, rvalue insert and operator[] semantics and that nothing is copied,
+/// including during the resizes, also works for move only values
+template <template <typename ...> class HashTable>
+void testEmplace() {
+	HashTable<int, CopyCounted> ht;
+	CopyCounted::copies = 0;
+	for (int c = 0; c < 10000; c++) {
+		switch (c % 4) {
+		case 0:
+			ht.insert(c, CopyCounted(c));
+			break;
+		case 1: {
+			const bool inserted = ht.try_emplace(c, c).second;
+			assert(inserted);
+			break;
+		}
+		case 2: {
+			const bool inserted = ht.emplace(c, CopyCounted(c)).second;
+			assert(inserted);
+			break;
+		}
+		default:
+			ht[c].value = c;
+		}
+	}
+	assert(CopyCounted::copies == 0);
+	assert(ht.size() == 10000);
+
+	// present keys are not overwritten by try_emplace and emplace, but are by insert and operator[]
+	const bool tryEmplaced = ht.try_emplace(5, -1).second;
+	const bool emplaced = ht.emplace(6, -1).second;
+	assert(!tryEmplaced && ht.find(5)->second.value == 5);
+	assert(!emplaced && ht.find(6)->second.value == 6);
+	ht.insert(7, CopyCounted(-7));
+	ht[8] = CopyCounted(-8);
+	assert(ht.find(7)->second.value == -7 && ht.find(8)->second.value == -8);
+	assert(ht.size() == 10000 && CopyCounted::copies == 0);
+	for (int c = 9; c < 10000; c++) {
+		assert(ht.find(c)->second.value == c);
+	}
+
+	HashTable<std::string, std::unique_ptr<int>> owners;
+	for (int c = 0; c < 1000; c++) {
+		std::string key = "key-" + std::to_string(c);
+		owners.insert(std::move(key), std::unique_ptr<int>(new int(c)));
+	}
+	std::unique_ptr<int> unused(new int(-1));
+	const bool ownerEmplaced = owners.try_emplace("key-1", std::move(unused)).second;
+	assert(!ownerEmplaced);
+	// try_emplace must not move from its arguments when the key is present
+	assert(unused && *owners["key-1"] == 1);
+	// operator[] inserts an empty pointer for a missing key
+	const bool missingEmpty = !owners["missing"];
+	assert(missingEmpty && owners.size() == 1001);
+}
+
+/// Check that stats() agrees with the table contents and, if compiled with HASH_TABLE_STATS, with the operations done
+template <template <typename ...> class HashTable>
+void testStats(bool hasTombstones) {
+	HashTable<int, int> ht;
+	for (int c = 0; c < 1000; c++) {
+		ht.insert(c, c);
+	}
+	for (int c = 0; c < 100; c++) {
+		ht.erase(c);
+	}
+	for (int c = 0; c < 2000; c++) {
+		ht.find(c);
+	}
+
+	const HashTableStats stats = ht.stats();
+	assert(stats.size == 900 && stats.buckets > 900);
+	int histogramTotal = 0;
+	for (int count : stats.probeHistogram) {
+		histogramTotal += count;
+	}
+	assert(histogramTotal == 900);
+	assert(stats.longestChain == int(stats.probeHistogram.size()) && stats.probeHistogram.back() > 0);
+	assert(stats.tombstones == (hasTombstones ? 100 : 0));
+	if (stats.counted) {
+		// erase by key also does a find
+		assert(stats.counters.finds == 2100 && stats.counters.findHits == 1000);
+		assert(stats.counters.inserts == 1000 && stats.counters.erases == 100);
+		// every hit compares at least one key, misses in empty chains compare none
+		assert(stats.counters.resizes > 0 && stats.counters.probes >= 1000);
+	}
+}
+
+/// Print the stats of one table after each of the testTable scenarios
+template <template <typename ...> class HashTable>
+void dumpStats(const char *name, int count) {
+	std::mt19937 generator(42);
+	char key[128], value[128];
+	{
+		HashTable<int, int> ht;
+		for (int c = 0; c < count; c++) {
+			ht.insert(c, c + 1);
+		}
+		for (int c = 0; c < count * 2; c++) {
+			ht.find(c);
+		}
+		for (int c = 0; c < count; c += 4) {
+			ht.erase(c);
+		}
+		printf("%s, sequential ints:\n", name);
+		ht.stats().print();
+	}
+	{
+		HashTable<std::string, std::string> ht;
+		for (int c = 0; c < count; c++) {
+			snprintf(key, sizeof(key), "key-%u-%u", unsigned(generator()), unsigned(generator()));
+			snprintf(value, sizeof(value), "val-%d", c);
+			ht[key] = value;
+			ht.find(key);
+		}
+		printf("%s, random strings:\n", name);
+		ht.stats().print();
+	}
+	{
+		HashTable<std::string, std::string> ht;
+		// each key is inserted about 10 times
+		for (int c = 0; c < count; c++) {
+			snprintf(key, sizeof(key), "key-%u", unsigned(generator() % (count / 10 + 1)));
+			snprintf(value, sizeof(value), "val-%d", c);
+			ht[key] = value;
+			ht.find(key);
+		}
+		printf("%s, collision strings:\n", name);
+		ht.stats().print();
+	}
+}
+
+/// Check reserve, max_load_factor, rehash and shrink_to_fit keep all elements and size the table as documented
+template <template <typename ...> class HashTable>
+void testReserve() {
+	HashTable<int, int> ht;
+	ht.reserve(10000);
+	const int reserved = ht.bucket_count();
+	assert((reserved & (reserved - 1)) == 0 && reserved * ht.max_load_factor() >= 10000);
+	for (int c = 0; c < 10000; c++) {
+		ht.insert(c, c);
+	}
+	assert(ht.bucket_count() == reserved);
+
+	// lowering the load factor grows the table right away
+	ht.max_load_factor(0.25f);
+	assert(ht.bucket_count() * 0.25f >= ht.size());
+	for (int c = 10000; c < 20000; c++) {
+		ht.insert(c, c);
+		// the load is checked before inserting, so it can be one element above the limit
+		assert(ht.bucket_count() * 0.25f >= ht.size() - 1);
+	}
+
+	for (int c = 0; c < 19000; c++) {
+		ht.erase(c);
+	}
+	const int before = ht.bucket_count();
+	ht.shrink_to_fit();
+	assert(ht.bucket_count() < before && ht.bucket_count() * 0.25f >= ht.size());
+	ht.rehash(1 << 14);
+	assert(ht.bucket_count() == 1 << 14);
+	ht.rehash(100);
+	assert(ht.bucket_count() < 1 << 14);
+
+	assert(ht.size() == 1000);
+	for (int c = 0; c < 20000; c++) {
+		assert((ht.find(c) != ht.end()) == (c >= 19000));
+	}
+
+	// after insert and erase churn, reserve must still leave room for the new keys next to any tombstones
+	HashTable<int, int> churned;
+	for (int c = 0; c < 100000; c++) {
+		churned.insert(c, c);
+		if (c >= 10) {
+			churned.erase(c - 10);
+		}
+		if (c % 1000 == 999) {
+			churned.reserve(churned.size() + 500);
+			const int buckets = churned.bucket_count();
+			for (int r = 0; r < 500; r++) {
+				churned.insert(-1 - r, r);
+			}
+			assert(churned.bucket_count() == buckets);
+			for (int r = 0; r < 500; r++) {
+				churned.erase(-1 - r);
+			}
+		}
+	}
+	assert(churned.size() == 10);
+}
+
+/// Keep a few live keys and replace the oldest one with a new key many times, like benchmarkChurn
+/// Tables with tombstones must re-hash when they fill up with them, otherwise probing for a missing key never ends
+template <template <typename ...> class HashTable>
+void testChurn() {
+	for (int live : {1, 10, 100, 2000}) {
+		HashTable<int, int> ht;
+		for (int c = 0; c < live; c++) {
+			ht.insert(c, c);
+		}
+		for (int c = live; c < 50000; c++) {
+			ht.erase(c - live);
+			assert(ht.find(c - live) == ht.end());
+			ht.insert(c, c);
+			assert(ht.size() == live);
+		}
+		for (int c = 50000 - live; c < 50000; c++) {
+			assert(ht.find(c) != ht.end() && ht.find(c)->second == c);
+		}
+	}
+}
+
+/// Grow, shrink and re-hash a table large enough for the parallel resize and check all keys are still found once
+template <template <typename ...> class HashTable>
+void testParallelResize() {
+	HashTable<int, int> ht;
+	ht.setResizeThreads(4);
+	const int count = 300000;
+	for (int c = 0; c < count; c++) {
+		ht.insert(c * 3, c);
+	}
+	// leave tombstones for the open addressing re-hash to drop
+	for (int c = 0; c < count; c += 3) {
+		ht.erase(c * 3);
+	}
+	ht.rehash(ht.bucket_count() * 4);
+	ht.shrink_to_fit();
+	ht.rehash(ht.bucket_count() * 2);
+
+	assert(ht.size() == count - count / 3);
+	for (int c = 0; c < count; c++) {
+		typename HashTable<int, int>::iterator it = ht.find(c * 3);
+		assert((it != ht.end()) == (c % 3 != 0));
+		assert(it == ht.end() || it->second == c);
+	}
+	int iterated = 0;
+	for (typename HashTable<int, int>::iterator it = ht.begin(); it != ht.end(); ++it) {
+		++iterated;
+	}
+	assert(iterated == ht.size());
+}
+
+/// Time in milliseconds since some fixed point
+double nowMs() {
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+/// Insert count random keys into empty table, with or without reserve before that, print the time
+template <typename HashTable>
+void benchmarkBulkLoad(const char *name, const std::vector<int> &keys, bool reserve) {
+	const double start = nowMs();
+	HashTable ht;
+	if (reserve) {
+		ht.reserve(keys.size());
+	}
+	for (int c = 0; c < int(keys.size()); c++) {
+		ht.insert(keys[c], c);
+	}
+	printf("%s%s: %.1f ms, %d buckets\n", name, reserve ? " with reserve" : "", nowMs() - start, ht.bucket_count());
+}
+
+/// Fill a table with count random keys and time doubling it with 1, 2, 4 ... maxThreads resize threads
+/// The table is shrunk back between the measurements, that re-hash is not timed
+template <typename HashTable>
+void benchmarkParallelResize(const char *name, int count, int maxThreads) {
+	HashTable ht;
+	std::mt19937 generator(42);
+	ht.reserve(count);
+	for (int c = 0; c < count; c++) {
+		ht.insert(int(generator()), c);
+	}
+	const int buckets = ht.bucket_count();
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		ht.setResizeThreads(threads);
+		const double start = nowMs();
+		ht.rehash(buckets * 2);
+		const double elapsed = nowMs() - start;
+		printf("%s: %2d threads, %d -> %d buckets in %.1f ms\n", name, threads, buckets, ht.bucket_count(), elapsed);
+		ht.rehash(buckets);
+	}
+}
+
+/// Print probe lengths for tables that can report them
+template <typename HashTable>
+void printProbeLength(const HashTable &) {}
+
+template <typename K, typename T, typename Hash>
+void printProbeLength(const RobinHoodHashTable<K, T, Hash> &ht) {
+	printf(", probe length avg %.2f max %d", ht.averageProbeLength(), ht.maxProbeLength());
+}
+
+/// Keep liveCount keys in the table and replace the oldest key with a new one for each cycle
+/// Prints the time per round and for the robin hood table also the probe lengths,
+/// which must not grow with the number of cycles since there are no tombstones.
+/// The table with tombstones has to re-hash whenever they fill it up, which shows as slower rounds
+template <typename HashTable>
+void benchmarkChurn(const char *name, int liveCount, int cycles) {
+	printf("%s: %d live keys, %d insert/erase cycles\n", name, liveCount, cycles);
+	HashTable ht;
+	// multiply by odd constant is bijection over 32 bit integers, so all keys are unique
+	auto makeKey = [](unsigned id) { return int(id * 2654435761u); };
+
+	unsigned nextId = 0;
+	for (int c = 0; c < liveCount; c++) {
+		ht.insert(makeKey(nextId++), c);
+	}
+
+	const int rounds = 10;
+	for (int r = 0; r < rounds; r++) {
+		const double start = nowMs();
+		for (int c = 0; c < cycles / rounds; c++) {
+			ht.erase(makeKey(nextId - liveCount));
+			ht.insert(makeKey(nextId++), c);
+		}
+		const double elapsed = nowMs() - start;
+		printf("round %d: %.1f ns/cycle", r, elapsed * 1e6 / (cycles / rounds));
+		printProbeLength(ht);
+		puts("");
+	}
+	assert(ht.size() == liveCount);
+}
+
+/// Insert count sequential keys and record the time of each insert
+/// Prints the total time, the 99.9th percentile and the worst single insert
+void benchmarkInsertLatency(const char *name, int count, int bucketsPerOperation) {
+	COHashTable<int, int> ht;
+	ht.setIncrementalResize(bucketsPerOperation);
+
+	std::vector<float> times(count);
+	const double start = nowMs();
+	for (int c = 0; c < count; c++) {
+		const double opStart = nowMs();
+		ht.insert(c, c);
+		times[c] = float(nowMs() - opStart);
+	}
+	const double total = nowMs() - start;
+
+	std::sort(times.begin(), times.end());
+	printf("%s: %d inserts in %.1f ms, p99.9 %.4f ms, worst %.3f ms\n",
+		name, count, total, times[count - count / 1000 - 1], times.back());
+}
+
+/// COHashTable behind one global mutex, the baseline for ConcurrentHashTable
+class GlobalLockHashTable {
+	std::mutex lock;
+	COHashTable<int, int> table;
+public:
+	bool find(int key, int &value) {
+		std::lock_guard<std::mutex> guard(lock);
+		COHashTable<int, int>::iterator it = table.find(key);
+		if (it == table.end()) {
+			return false;
+		}
+		value = it->second;
+		return true;
+	}
+
+	void insert(int key, int value) {
+		std::lock_guard<std::mutex> guard(lock);
+		table.insert(key, value);
+	}
+};
+
+/// Run threadCount threads doing lookups and some inserts over keyCount keys
+/// Returns millions of operations per second
+template <typename HashTable>
+double concurrentThroughput(HashTable &ht, int threadCount, int keyCount, int opsPerThread) {
+	std::vector<std::thread> threads;
+	const double start = nowMs();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&ht, t, keyCount, opsPerThread]() {
+			std::mt19937 generator(t);
+			std::uniform_int_distribution<int> keys(0, keyCount - 1);
+			int found = 0;
+			for (int c = 0; c < opsPerThread; c++) {
+				const int key = keys(generator);
+				// 1 in 10 operations is a write
+				if (c % 10 == 0) {
+					ht.insert(key, c);
+				} else {
+					int value;
+					found += ht.find(key, value);
+				}
+			}
+			assert(found > 0);
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	const double elapsed = nowMs() - start;
+	return double(threadCount) * opsPerThread / elapsed / 1000;
+}
+
+/// Compare throughput of the sharded table and global mutex from 1 to maxThreads threads
+void benchmarkConcurrent(int keyCount, int opsPerThread, int maxThreads) {
+	ConcurrentHashTable<int, int> sharded;
+	GlobalLockHashTable global;
+	for (int c = 0; c < keyCount; c++) {
+		sharded.insert(c, c);
+		global.insert(c, c);
+	}
+
+	printf("%d keys, %d operations per thread, 10%% writes\n", keyCount, opsPerThread);
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		const double shardedOps = concurrentThroughput(sharded, threads, keyCount, opsPerThread);
+		const double globalOps = concurrentThroughput(global, threads, keyCount, opsPerThread);
+		printf("%2d threads: sharded %.2f Mops/s, global mutex %.2f Mops/s\n", threads, shardedOps, globalOps);
+	}
+	assert(sharded.size() == keyCount);
+}
+
+/// Increment random keys from threadCount threads and compare the counts with a sequential std::unordered_map
+/// Returns millions of increments per second
+double stressLockFree(int threadCount, int keyCount, int opsPerThread) {
+	LockFreeIntHashTable ht(16); // start small so the threads go through many resizes
+	std::vector<std::thread> threads;
+	const double start = nowMs();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&ht, t, keyCount, opsPerThread]() {
+			std::mt19937 generator(t);
+			std::uniform_int_distribution<int> keys(0, keyCount - 1);
+			for (int c = 0; c < opsPerThread; c++) {
+				ht.add(keys(generator), 1);
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	const double elapsed = nowMs() - start;
+
+	std::unordered_map<int, int> reference;
+	for (int t = 0; t < threadCount; t++) {
+		std::mt19937 generator(t);
+		std::uniform_int_distribution<int> keys(0, keyCount - 1);
+		for (int c = 0; c < opsPerThread; c++) {
+			++reference[keys(generator)];
+		}
+	}
+
+	if (ht.size() != int(reference.size())) {
+		printf("size mismatch %d != %d\n", ht.size(), int(reference.size()));
+		assert(false);
+	}
+	for (const std::pair<const int, int> &item : reference) {
+		int value = 0;
+		if (!ht.find(item.first, value) || value != item.second) {
+			printf("count mismatch for %d: %d != %d\n", item.first, value, item.second);
+			assert(false);
+		}
+	}
+	return double(threadCount) * opsPerThread / elapsed / 1000;
+}
+
+/// Insert the same random string keys in the table, print allocations per insert, total and worst insert time
+/// The worst insert is the one doing the last resize
+template <typename HashTable>
+void benchmarkStringStorage(const char *name, const std::vector<std::string> &keys) {
+	HashTable ht;
+	const std::string value = "value";
+	double worst = 0;
+
+	const long long allocations = allocationCount.load();
+	const double start = nowMs();
+	for (const std::string &key : keys) {
+		const double opStart = nowMs();
+		ht.insert(key, value);
+		worst = std::max(worst, nowMs() - opStart);
+	}
+	const double total = nowMs() - start;
+	const double perInsert = double(allocationCount.load() - allocations) / keys.size();
+
+	printf("%s: %.3f allocations per insert, total %.1f ms, largest resize %.2f ms\n", name, perInsert, total, worst);
+}
+
+/// Look up random present keys one by one and in batches, prints nanoseconds per lookup
+template <typename HashTable>
+void benchmarkBatchFind(const char *name, int count, int lookups, int batchSize) {
+	HashTable ht;
+	std::mt19937 generator(42);
+	std::vector<std::pair<int, int>> items(count);
+	for (int c = 0; c < count; c++) {
+		items[c] = std::make_pair(int(generator()), c);
+	}
+	ht.insert_batch(items);
+
+	std::vector<int> keys(batchSize);
+	std::vector<typename HashTable::iterator> result;
+	long long checksum = 0;
+	double single = 0, batched = 0;
+	for (int r = 0; r < lookups / batchSize; r++) {
+		for (int c = 0; c < batchSize; c++) {
+			keys[c] = items[generator() % count].first;
+		}
+
+		double start = nowMs();
+		for (int c = 0; c < batchSize; c++) {
+			checksum += ht.find(keys[c])->second;
+		}
+		single += nowMs() - start;
+
+		start = nowMs();
+		ht.find_batch(keys, result);
+		for (int c = 0; c < batchSize; c++) {
+			checksum -= result[c]->second;
+		}
+		batched += nowMs() - start;
+	}
+	assert(checksum == 0);
+
+	const double scale = 1e6 / (lookups / batchSize * batchSize);
+	printf("%s: %d keys, one by one %.1f ns/lookup, batched %.1f ns/lookup\n", name, count, single * scale, batched * scale);
+}
+
+/// Insert random keys into CuckooHashTable and return the lowest load factor at which it had to grow
+/// Growing is detected as a drop of the load factor, only tables with more than minCount elements count
+float cuckooGrowLoad(int count, int minCount) {
+	CuckooHashTable<int, int> ht;
+	std::mt19937 generator(42);
+	float lowest = 1, previous = 0;
+	for (int c = 0; c < count; c++) {
+		ht.insert(int(generator()), c);
+		const float load = ht.loadFactor();
+		if (load < previous && ht.size() > minCount) {
+			lowest = std::min(lowest, previous);
+		}
+		previous = load;
+	}
+	return lowest;
+}
+
+/// Look up random present keys and print nanoseconds per lookup and the final load factor
+template <typename HashTable>
+void benchmarkLookup(const char *name, int count, int lookups) {
+	HashTable ht;
+	std::mt19937 generator(42);
+	std::vector<int> keys(count);
+	for (int c = 0; c < count; c++) {
+		keys[c] = int(generator());
+		ht.insert(keys[c], c);
+	}
+	long long checksum = 0;
+	const double start = nowMs();
+	for (int c = 0; c < lookups; c++) {
+		checksum += ht.find(keys[generator() % count])->second;
+	}
+	const double elapsed = nowMs() - start;
+	printf("%s: %d keys, %.1f ns/lookup (checksum %lld)\n", name, count, elapsed * 1e6 / lookups, checksum);
+}
+
+/// SoAHashTable can't go through testTable since its iterator returns references instead of std::pair
+/// Insert, overwrite, erase and re-insert string keys and compare with std::unordered_map
+void testSoA() {
+	SoAHashTable<std::string, std::string> ht;
+	std::unordered_map<std::string, std::string> stdMap;
+	std::mt19937 generator(42);
+	for (int c = 0; c < 20000; c++) {
+		const std::string key = "key-" + std::to_string(generator() % 8000);
+		const std::string value = "value-" + std::to_string(c);
+		switch (generator() % 3) {
+		case 0:
+			ht.insert(key, value);
+			stdMap[key] = value;
+			break;
+		case 1:
+			ht[key] = value;
+			stdMap[key] = value;
+			break;
+		default:
+			ht.erase(key);
+			stdMap.erase(key);
+		}
+	}
+
+	assert(ht.size() == int(stdMap.size()));
+	for (const std::pair<const std::string, std::string> &item : stdMap) {
+		SoAHashTable<std::string, std::string>::iterator it = ht.find(item.first);
+		assert(it != ht.end() && it->first == item.first && it->second == item.second);
+	}
+	int iterated = 0;
+	for (SoAHashTable<std::string, std::string>::iterator it = ht.begin(); it != ht.end(); ++it) {
+		assert(stdMap.at(it->first) == it->second);
+		++iterated;
+	}
+	assert(iterated == ht.size());
+	assert(ht.find("missing") == ht.end());
+}
+
+/// Value of fixed size for the layout benchmark
+template <int Size>
+struct Payload {
+	char data[Size];
+};
+
+/// Look up present and missing string keys in the table, reading one byte of each found value
+/// Returns nanoseconds per hit and per miss in hit and miss
+template <typename HashTable>
+void measureLayout(const std::vector<std::string> &keys, const std::vector<std::string> &missing, int lookups, double &hit, double &miss) {
+	typedef typename HashTable::value_type value_type;
+	HashTable ht;
+	value_type value;
+	memset(&value, 1, sizeof(value));
+	for (const std::string &key : keys) {
+		ht.insert(key, value);
+	}
+
+	std::mt19937 generator(42);
+	long long checksum = 0;
+	double start = nowMs();
+	for (int c = 0; c < lookups; c++) {
+		checksum += (*ht.find(keys[generator() % keys.size()])).second.data[0];
+	}
+	hit = (nowMs() - start) * 1e6 / lookups;
+
+	start = nowMs();
+	for (int c = 0; c < lookups; c++) {
+		checksum += ht.find(missing[generator() % missing.size()]) == ht.end();
+	}
+	miss = (nowMs() - start) * 1e6 / lookups;
+	assert(checksum == 2ll * lookups);
+}
+
+/// Compare OOHashTable and SoAHashTable with string keys and values of Size bytes
+template <int Size>
+void benchmarkLayout(const std::vector<std::string> &keys, const std::vector<std::string> &missing, int lookups) {
+	double aosHit, aosMiss, soaHit, soaMiss;
+	measureLayout<OOHashTable<std::string, Payload<Size>>>(keys, missing, lookups, aosHit, aosMiss);
+	measureLayout<SoAHashTable<std::string, Payload<Size>>>(keys, missing, lookups, soaHit, soaMiss);
+	printf("%3d byte values: hit %.1f / %.1f ns, miss %.1f / %.1f ns (buckets / arrays)\n", Size, aosHit, soaHit, aosMiss, soaMiss);
+}
+
+/// Check that DenseHashTable iterates in insertion order, keeps the position of overwritten keys
+/// and compacts the holes left by erase
+void testDenseOrder() {
+	DenseHashTable<int, int> ht;
+	for (int c = 0; c < 1000; c++) {
+		ht.insert(c * 31 % 1000, c);
+	}
+	ht.insert(0, -1);
+	ht[31] = -2;
+	for (int c = 0; c < 1000; c += 2) {
+		const DenseHashTable<int, int>::iterator next = ht.erase(c * 31 % 1000);
+		assert(next != ht.end());
+	}
+	// erased keys inserted again go to the end of the order
+	ht.insert(0, 5);
+
+	int expected = 1;
+	int iterated = 0;
+	for (DenseHashTable<int, int>::iterator it = ht.begin(); it != ht.end(); ++it, ++iterated) {
+		if (expected < 1000) {
+			assert(it->first == expected * 31 % 1000 && it->second == (expected == 1 ? -2 : expected));
+			expected += 2;
+		} else {
+			assert(it->first == 0 && it->second == 5);
+		}
+	}
+	assert(iterated == 501 && ht.size() == 501);
+
+	// erase while iterating, the compaction inside erase must not skip elements
+	iterated = 0;
+	for (DenseHashTable<int, int>::iterator it = ht.begin(); it != ht.end(); ++iterated) {
+		it = ht.erase(it);
+	}
+	assert(iterated == 501 && ht.size() == 0 && ht.begin() == ht.end());
+	assert(ht.bucket_count() < 64);
+}
+
+/// Insert count random keys, then time iteration over all of them and again after erasing 90% of the keys
+template <typename HashTable>
+void benchmarkIteration(const char *name, int count, int passes) {
+	HashTable ht;
+	std::mt19937 generator(42);
+	std::vector<int> keys(count);
+	for (int c = 0; c < count; c++) {
+		keys[c] = int(generator());
+		ht.insert(keys[c], 1);
+	}
+
+	double perElement[2];
+	for (int round = 0; round < 2; round++) {
+		long long checksum = 0;
+		const double start = nowMs();
+		for (int pass = 0; pass < passes; pass++) {
+			for (typename HashTable::iterator it = ht.begin(); it != ht.end(); ++it) {
+				checksum += it->second;
+			}
+		}
+		perElement[round] = (nowMs() - start) * 1e6 / (double(passes) * ht.size());
+		assert(checksum == (long long)passes * ht.size());
+
+		for (int c = 0; c < count; c++) {
+			if (c % 10) {
+				ht.erase(keys[c]);
+			}
+		}
+	}
+	printf("%s: %.2f ns/element full, %.2f ns/element after erasing 90%%, %d buckets\n", name, perElement[0], perElement[1], ht.bucket_count());
+}
+
+/// Bytes per element allocated by a table with count int keys and Size byte values
+template <typename HashTable>
+double measureMemory(int count) {
+	typedef typename HashTable::value_type value_type;
+	const long long before = allocatedBytes.load();
+	HashTable ht;
+	value_type value;
+	memset(&value, 1, sizeof(value));
+	for (int c = 0; c < count; c++) {
+		ht.insert(c, value);
+	}
+	return double(allocatedBytes.load() - before) / count;
+}
+
+/// Compare memory of OOHashTable, COHashTable and DenseHashTable for values of Size bytes
+template <int Size>
+void benchmarkMemory(int count) {
+	const double oo = measureMemory<OOHashTable<int, Payload<Size>>>(count);
+	const double co = measureMemory<COHashTable<int, Payload<Size>>>(count);
+	const double dense = measureMemory<DenseHashTable<int, Payload<Size>>>(count);
+	printf("%3d byte values: %.1f / %.1f / %.1f bytes per element (open / closed / dense)\n", Size, oo, co, dense);
+}
+
+/// Print hashing speed of Hash in GB/s for keys of a few lengths, the keys are windows of one random buffer
+/// Each key starts where the previous hash points, so this is the speed of dependent calls, as in probing a table
+template <typename Hash>
+void benchmarkHashSpeed(const char *name) {
+	const int lengths[] = {8, 16, 32, 64, 256, 4096};
+	std::string buffer(1 << 16, ' ');
+	std::mt19937 generator(42);
+	for (char &c : buffer) {
+		c = char(generator());
+	}
+	// 2^k - 1 mask over the first half of the buffer, so any offset plus the longest key stays inside it
+	const size_t window = buffer.size() / 2 - 1;
+	assert(window + 1 >= size_t(lengths[sizeof(lengths) / sizeof(lengths[0]) - 1]));
+	Hash hasher;
+	printf("%-12s", name);
+	for (int length : lengths) {
+		const long long bytes = 1ll << 28;
+		const int count = int(bytes / length);
+		size_t checksum = 0;
+		const double start = nowMs();
+		for (int c = 0; c < count; c++) {
+			// the offset depends on all bits of the previous hash, so the calls can't be hoisted or overlapped
+			const size_t offset = (c * 61 + checksum) & window;
+			checksum += hasher(std::string_view(buffer.data() + offset, length));
+		}
+		const double elapsed = nowMs() - start;
+		printf(" %4d B: %6.2f GB/s", length, bytes / elapsed / 1e6);
+		// keep checksum alive
+		if (checksum == 42) {
+			puts("");
+		}
+	}
+	printf("\n");
+}
+
+/// Insert keys into OOHashTable with hash Hash and print the probe lengths and time to insert and find all keys
+template <typename K, typename Hash>
+void benchmarkHashProbes(const char *workload, const char *name, const std::vector<K> &keys) {
+	OOHashTable<K, int, Hash> ht;
+	double start = nowMs();
+	for (int c = 0; c < int(keys.size()); c++) {
+		ht.insert(keys[c], c);
+	}
+	const double inserted = nowMs() - start;
+	long long checksum = 0;
+	start = nowMs();
+	for (const K &key : keys) {
+		checksum += ht.find(key) != ht.end();
+	}
+	const double found = nowMs() - start;
+	assert(checksum == (long long)keys.size());
+	const HashTableStats stats = ht.stats();
+	printf("%-18s %-12s average probe %.3f, longest %3d, insert %.1f ms, find %.1f ms\n",
+		workload, name, stats.averageProbe(), stats.longestChain, inserted, found);
+}
+
+/// Check that the hash functors work as table hashes and that hashBytes sees every byte of keys of all lengths
+void testHashFunctions() {
+	OOHashTable<std::string, int, FastStringHash> strings;
+	COHashTable<int, int, IntMixHash> ints;
+	std::string key;
+	for (int c = 0; c < 300; c++) {
+		strings.insert(key, c);
+		ints.insert(c << 20, c);
+		key += char('a' + c % 26);
+	}
+	key.clear();
+	for (int c = 0; c < 300; c++) {
+		assert(strings.find(std::string_view(key))->second == c && ints.find(c << 20)->second == c);
+		key += char('a' + c % 26);
+	}
+
+	// flipping any single byte must change the hash, for short keys and for all blocks of long ones
+	for (int length = 1; length < 100; length++) {
+		std::string bytes(length, 'x');
+		const size_t original = hashBytes(bytes.data(), length);
+		for (int c = 0; c < length; c++) {
+			bytes[c] ^= 1;
+			assert(hashBytes(bytes.data(), length) != original);
+			bytes[c] ^= 1;
+		}
+	}
+#ifdef __SSE4_2__
+	OOHashTable<std::string, int, Crc32cHash> crc;
+	crc.insert("crc", 1);
+	assert(crc.find("crc")->second == 1 && crc.find(std::string_view("crc32")) == crc.end());
+#endif
+}
+
+/// Probe lengths of all string hashes for one workload
+void benchmarkStringHashProbes(const char *workload, const std::vector<std::string> &keys) {
+	benchmarkHashProbes<std::string, StringHash>(workload, "std::hash", keys);
+	benchmarkHashProbes<std::string, FastStringHash>(workload, "fast", keys);
+#ifdef __SSE4_2__
+	benchmarkHashProbes<std::string, Crc32cHash>(workload, "crc32c", keys);
+#endif
+}
+
+/// Join rows with duplicate keys on both sides and compare the inner and left outer results with a nested loop join
+void testHashJoin() {
+	std::vector<std::pair<int, int>> buildRows;
+	std::vector<std::pair<int, long long>> probeRows;
+	for (int c = 0; c < 3000; c++) {
+		buildRows.push_back(std::make_pair(c % 700, c));
+	}
+	for (int c = 0; c < 2000; c++) {
+		probeRows.push_back(std::make_pair(c * 7 % 1000, c));
+	}
+	long long expectedCount = 0, expectedSum = 0, unmatched = 0;
+	for (const std::pair<int, long long> &probe : probeRows) {
+		bool matched = false;
+		for (const std::pair<int, int> &build : buildRows) {
+			if (build.first == probe.first) {
+				++expectedCount;
+				expectedSum += probe.second * build.second;
+				matched = true;
+			}
+		}
+		unmatched += !matched;
+	}
+
+	const int threads = 4;
+	// small cache size, so there are many partitions
+	HashJoin<int, int> join(threads, 4096);
+	join.build(buildRows);
+	assert(join.size() == 3000 && join.partitionCount() > 1);
+	for (JoinType type : {JoinType::inner, JoinType::leftOuter}) {
+		std::vector<long long> count(threads, 0), sum(threads, 0), missing(threads, 0);
+		join.probe(probeRows, type, [&](int thread, const std::pair<int, long long> &probe, const std::pair<int, int> *build) {
+			if (!build) {
+				++missing[thread];
+				return;
+			}
+			assert(build->first == probe.first);
+			++count[thread];
+			sum[thread] += probe.second * build->second;
+		});
+		long long totalCount = 0, totalSum = 0, totalMissing = 0;
+		for (int t = 0; t < threads; t++) {
+			totalCount += count[t];
+			totalSum += sum[t];
+			totalMissing += missing[t];
+		}
+		assert(totalCount == expectedCount && totalSum == expectedSum);
+		assert(totalMissing == (type == JoinType::leftOuter ? unmatched : 0));
+	}
+}
+
+/// Join buildCount rows with unique keys and probeCount rows with keys in [0, 2 * buildCount), so about half of the probe rows match
+/// Compare the partitioned join with different thread counts and a single OOHashTable of the whole build side
+void benchmarkHashJoin(int buildCount, int probeCount, int maxThreads) {
+	std::mt19937 generator(42);
+	std::vector<std::pair<int, int>> buildRows(buildCount);
+	for (int c = 0; c < buildCount; c++) {
+		buildRows[c] = std::make_pair(c, c);
+	}
+	std::shuffle(buildRows.begin(), buildRows.end(), generator);
+	std::vector<std::pair<int, int>> probeRows(probeCount);
+	for (int c = 0; c < probeCount; c++) {
+		probeRows[c] = std::make_pair(int(generator() % (2u * buildCount)), c);
+	}
+
+	{
+		double start = nowMs();
+		OOHashTable<int, int> table;
+		table.reserve(buildCount);
+		for (const std::pair<int, int> &row : buildRows) {
+			table.insert(row.first, row.second);
+		}
+		const double built = nowMs() - start;
+		start = nowMs();
+		long long matches = 0;
+		for (const std::pair<int, int> &row : probeRows) {
+			matches += table.find(row.first) != table.end();
+		}
+		printf("single table: build %.1f ms, inner probe %.1f ms, %lld matches\n", built, nowMs() - start, matches);
+	}
+
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		HashJoin<int, int> join(threads);
+		double start = nowMs();
+		join.build(buildRows);
+		const double built = nowMs() - start;
+		double probed[2];
+		long long rowCount[2];
+		for (JoinType type : {JoinType::inner, JoinType::leftOuter}) {
+			// padded so the threads don't write to the same cache line
+			std::vector<long long> counts(threads * 8, 0);
+			start = nowMs();
+			join.probe(probeRows, type, [&counts](int thread, const std::pair<int, int> &, const std::pair<int, int> *) {
+				++counts[thread * 8];
+			});
+			const int idx = type == JoinType::inner ? 0 : 1;
+			probed[idx] = nowMs() - start;
+			rowCount[idx] = 0;
+			for (int t = 0; t < threads; t++) {
+				rowCount[idx] += counts[t * 8];
+			}
+		}
+		assert(rowCount[1] == probeCount);
+		printf("%2d threads, %d partitions: build %.1f ms, inner probe %.1f ms (%lld rows), left outer probe %.1f ms (%lld rows)\n",
+			threads, join.partitionCount(), built, probed[0], rowCount[0], probed[1], rowCount[1]);
+	}
+}
+
+/// Value with a few fields, to check snapshots of non scalar trivially copyable types
+struct SnapshotValue {
+	int id;
+	double score;
+};
+
+/// Save a table with erased keys and check the mapped snapshot finds exactly the live keys
+void testSnapshot() {
+	typedef OOHashTable<int, SnapshotValue> table_type;
+	const char *path = "oo-snapshot-test.bin";
+	table_type ht;
+	for (int c = 0; c < 10000; c++) {
+		ht.insert(c, SnapshotValue{c, c * 0.5});
+	}
+	for (int c = 0; c < 10000; c += 3) {
+		ht.erase(c);
+	}
+	const bool saved = ht.save_snapshot(path);
+	assert(saved);
+
+	{
+		table_type::snapshot_type snapshot = table_type::open_snapshot(path);
+		assert(snapshot.isOpen());
+		assert(snapshot.size() == ht.size());
+		for (int c = 0; c < 10000; c++) {
+			const SnapshotValue *value = snapshot.find(c);
+			if (c % 3 == 0) {
+				assert(!value);
+			} else {
+				assert(value && value->id == c && value->score == c * 0.5);
+			}
+		}
+		assert(!snapshot.find(-1) && !snapshot.find(10000));
+	}
+
+	// different value type must be rejected instead of reading garbage
+	typedef OOHashTable<int, long long> other_type;
+	assert(!other_type::open_snapshot(path).isOpen());
+	remove(path);
+	assert(!table_type::open_snapshot(path).isOpen());
+}
+
+/// Compare service start by re-inserting every key with mapping a snapshot, both followed by the first lookups
+/// The lookups after open include the page faults that load the touched parts of the file
+void benchmarkSnapshot(int count, int lookups, const char *path) {
+	std::mt19937 generator(42);
+	std::vector<std::pair<int, int>> items(count);
+	for (int c = 0; c < count; c++) {
+		items[c] = std::make_pair(int(generator()), c);
+	}
+	std::vector<int> keys(lookups);
+	for (int c = 0; c < lookups; c++) {
+		keys[c] = items[generator() % count].first;
+	}
+	long long checksum = 0;
+
+	double start = nowMs();
+	{
+		OOHashTable<int, int> ht;
+		for (const std::pair<int, int> &item : items) {
+			ht.insert(item.first, item.second);
+		}
+		const double built = nowMs() - start;
+		for (int key : keys) {
+			checksum += ht.find(key)->second;
+		}
+		printf("rebuild: insert %.1f ms, first %d lookups %.1f ms\n", built, lookups, nowMs() - start - built);
+
+		start = nowMs();
+		if (!ht.save_snapshot(path)) {
+			printf("failed to write %s\n", path);
+			return;
+		}
+		printf("save snapshot: %.1f ms\n", nowMs() - start);
+	}
+
+	start = nowMs();
+	{
+		OOHashTable<int, int>::snapshot_type snapshot = OOHashTable<int, int>::open_snapshot(path);
+		const double opened = nowMs() - start;
+		assert(snapshot.isOpen() && snapshot.size() <= count);
+		for (int key : keys) {
+			checksum -= *snapshot.find(key);
+		}
+		printf("snapshot: open %.3f ms, first %d lookups %.1f ms\n", opened, lookups, nowMs() - start - opened);
+	}
+	assert(checksum == 0);
+	remove(path);
+}
+
+int main(int argc, char *argv[])
 {
+	if (argc > 1 && !strcmp(argv[1], "churn")) {
+		const int liveCount = argc > 2 ? atoi(argv[2]) : 1000000;
+		const int cycles = argc > 3 ? atoi(argv[3]) : 5000000;
+		benchmarkChurn<RobinHoodHashTable<int, int>>("robin hood", liveCount, cycles);
+		benchmarkChurn<OOHashTable<int, int>>("open addressing with tombstones", liveCount, cycles);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "concurrent")) {
+		const int keyCount = argc > 2 ? atoi(argv[2]) : 1000000;
+		const int opsPerThread = argc > 3 ? atoi(argv[3]) : 2000000;
+		benchmarkConcurrent(keyCount, opsPerThread, 32);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "lockfree")) {
+		const int keyCount = argc > 2 ? atoi(argv[2]) : 1000000;
+		const int opsPerThread = argc > 3 ? atoi(argv[3]) : 4000000;
+		for (int threads = 1; threads <= 32; threads *= 2) {
+			printf("%2d threads: %.2f M increments/s\n", threads, stressLockFree(threads, keyCount, opsPerThread));
+		}
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "slab")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 2000000;
+		std::vector<std::string> keys;
+		std::mt19937 generator(42);
+		for (int c = 0; c < count; c++) {
+			char key[128];
+			// short keys fit in the small string buffer, so allocations come from the table only
+			snprintf(key, sizeof(key), "k%u", unsigned(generator()));
+			keys.push_back(key);
+		}
+		benchmarkStringStorage<COHashTable<std::string, std::string>>("vector chains", keys);
+		benchmarkStringStorage<SlabHashTable<std::string, std::string>>("slab chains", keys);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "batch")) {
+		// by default the tables take a few hundred MB, much larger than the last level cache
+		const int count = argc > 2 ? atoi(argv[2]) : 8000000;
+		const int lookups = argc > 3 ? atoi(argv[3]) : 10000000;
+		benchmarkBatchFind<OOHashTable<int, int>>("open addressing", count, lookups, 10000);
+		benchmarkBatchFind<COHashTable<int, int>>("closed addressing", count, lookups, 10000);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "snapshot")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 10000000;
+		const int lookups = argc > 3 ? atoi(argv[3]) : 1000000;
+		benchmarkSnapshot(count, lookups, argc > 4 ? argv[4] : "oo-snapshot.bin");
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "cuckoo")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 4000000;
+		const int lookups = argc > 3 ? atoi(argv[3]) : 10000000;
+		printf("cuckoo grows at load factor %.3f or more\n", cuckooGrowLoad(count, 10000));
+		benchmarkLookup<CuckooHashTable<int, int>>("cuckoo", count, lookups);
+		benchmarkLookup<GroupHashTable<int, int>>("group probing", count, lookups);
+		benchmarkLookup<OOHashTable<int, int>>("open addressing", count, lookups);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "soa")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 1000000;
+		const int lookups = argc > 3 ? atoi(argv[3]) : 5000000;
+		std::vector<std::string> keys, missing;
+		std::mt19937 generator(42);
+		for (int c = 0; c < count; c++) {
+			// short keys fit in the small string buffer, so probing doesn't chase pointers
+			keys.push_back("k" + std::to_string(c) + "-" + std::to_string(generator() % 1000));
+			missing.push_back("m" + std::to_string(c));
+		}
+		benchmarkLayout<8>(keys, missing, lookups);
+		benchmarkLayout<16>(keys, missing, lookups);
+		benchmarkLayout<32>(keys, missing, lookups);
+		benchmarkLayout<64>(keys, missing, lookups);
+		benchmarkLayout<128>(keys, missing, lookups);
+		benchmarkLayout<256>(keys, missing, lookups);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "hash")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 1000000;
+		benchmarkHashSpeed<StringHash>("std::hash");
+		benchmarkHashSpeed<FastStringHash>("fast");
+#ifdef __SSE4_2__
+		benchmarkHashSpeed<Crc32cHash>("crc32c");
+#else
+		puts("crc32c needs SSE 4.2, build with -msse4.2 or -march=native");
+#endif
+
+		// the same key shapes as the slab, soa and string map tests
+		std::vector<std::string> shortKeys, layoutKeys, testKeys;
+		std::mt19937 generator(42);
+		for (int c = 0; c < count; c++) {
+			char key[128];
+			snprintf(key, sizeof(key), "k%u", unsigned(generator()));
+			shortKeys.push_back(key);
+			layoutKeys.push_back("k" + std::to_string(c) + "-" + std::to_string(generator() % 1000));
+			snprintf(key, sizeof(key), "some-long-network-buffer-key-%d", c);
+			testKeys.push_back(key);
+		}
+		benchmarkStringHashProbes("random short", shortKeys);
+		benchmarkStringHashProbes("sequential short", layoutKeys);
+		benchmarkStringHashProbes("sequential long", testKeys);
+
+		std::vector<int> intKeys(count);
+		for (int c = 0; c < count; c++) {
+			// multiples of a power of 2 leave the low bits of identity hashes zero
+			intKeys[c] = c * 1024;
+		}
+		benchmarkHashProbes<int, std::hash<int>>("strided ints", "std::hash", intKeys);
+		benchmarkHashProbes<int, IntMixHash>("strided ints", "mix", intKeys);
+#ifdef __SSE4_2__
+		benchmarkHashProbes<int, Crc32cHash>("strided ints", "crc32c", intKeys);
+#endif
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "join")) {
+		// by default needs about 2.5 GB, the probe side is copied while it is partitioned
+		const int buildCount = argc > 2 ? atoi(argv[2]) : 10000000;
+		const int probeCount = argc > 3 ? atoi(argv[3]) : 100000000;
+		const int maxThreads = argc > 4 ? atoi(argv[4]) : 32;
+		benchmarkHashJoin(buildCount, probeCount, maxThreads);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "dense")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 1000000;
+		const int passes = argc > 3 ? atoi(argv[3]) : 20;
+		benchmarkIteration<OOHashTable<int, int>>("open addressing", count, passes);
+		benchmarkIteration<COHashTable<int, int>>("closed addressing", count, passes);
+		benchmarkIteration<DenseHashTable<int, int>>("dense", count, passes);
+		benchmarkMemory<8>(count);
+		benchmarkMemory<32>(count);
+		benchmarkMemory<128>(count);
+		benchmarkMemory<512>(count);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "stats")) {
+		// build with -DHASH_TABLE_STATS to also get the operation counters
+		const int count = argc > 2 ? atoi(argv[2]) : 100000;
+		dumpStats<COHashTable>("closed addressing", count);
+		dumpStats<IncrementalCOHashTable>("closed addressing with incremental resize", count);
+		dumpStats<OOHashTable>("open addressing", count);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "reserve")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 10000000;
+		std::vector<int> keys(count);
+		std::mt19937 generator(42);
+		for (int &key : keys) {
+			key = int(generator());
+		}
+		benchmarkBulkLoad<OOHashTable<int, int>>("open addressing", keys, false);
+		benchmarkBulkLoad<OOHashTable<int, int>>("open addressing", keys, true);
+		benchmarkBulkLoad<COHashTable<int, int>>("closed addressing", keys, false);
+		benchmarkBulkLoad<COHashTable<int, int>>("closed addressing", keys, true);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "resize")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 20000000;
+		const int maxThreads = argc > 3 ? atoi(argv[3]) : 32;
+		benchmarkParallelResize<OOHashTable<int, int>>("open addressing", count, maxThreads);
+		benchmarkParallelResize<COHashTable<int, int>>("closed addressing", count, maxThreads);
+		return 0;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "latency")) {
+		const int count = argc > 2 ? atoi(argv[2]) : 10000000;
+		benchmarkInsertLatency("full resize", count, 0);
+		benchmarkInsertLatency("incremental resize", count, 8);
+		return 0;
+	}
+
 	puts("- closed addressing hash table");
 	testTable<COHashTable>();
 	puts("- done");
 
+	puts("- concurrent sharded hash table");
+	{
+		ConcurrentHashTable<int, int> ht(8);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([&ht]() {
+				for (int c = 0; c < 10000; c++) {
+					ht.update(c, [](int &value) { ++value; });
+				}
+			});
+		}
+		// lookups share the shard lock, so they run together, with HASH_TABLE_STATS they also count
+		std::atomic<int> found(0);
+		for (int t = 0; t < 2; t++) {
+			threads.emplace_back([&ht, &found]() {
+				int value = 0;
+				for (int c = 0; c < 10000; c++) {
+					found += ht.find(c, value) + ht.contains(c);
+				}
+			});
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+		assert(ht.size() == 10000);
+		for (const std::pair<int, int> &item : ht.snapshot()) {
+			assert(item.second == 4);
+		}
+		ht[5] = 42;
+		int value = 0;
+		const bool foundFive = ht.find(5, value);
+		assert(foundFive && value == 42);
+		const bool erasedFive = ht.erase(5);
+		const bool containsFive = ht.contains(5);
+		assert(erasedFive && !containsFive);
+	}
+	puts("- done");
+
+	puts("- lock free int hash table");
+	stressLockFree(8, 20000, 50000);
+	puts("- done");
+
+	puts("- transparent string lookups");
+	testTransparentFind<COHashTable>();
+	testTransparentFind<OOHashTable>();
+	puts("- done");
+
+	puts("- batched find and insert");
+	testBatch<COHashTable>();
+	testBatch<IncrementalCOHashTable>();
+	testBatch<OOHashTable>();
+	puts("- done");
+
+	puts("- memory mapped snapshot");
+	testSnapshot();
+	puts("- done");
+
+	puts("- emplace and move aware insert");
+	testEmplace<COHashTable>();
+	testEmplace<IncrementalCOHashTable>();
+	testEmplace<OOHashTable>();
+	puts("- done");
+
+	puts("- table stats");
+	testStats<COHashTable>(false);
+	testStats<IncrementalCOHashTable>(false);
+	testStats<OOHashTable>(true);
+	puts("- done");
+
+	puts("- reserve and load factor");
+	testReserve<COHashTable>();
+	testReserve<IncrementalCOHashTable>();
+	testReserve<OOHashTable>();
+	puts("- done");
+
+	puts("- insert and erase churn");
+	testChurn<COHashTable>();
+	testChurn<OOHashTable>();
+	testChurn<SoAHashTable>();
+	testChurn<GroupHashTable>();
+	testChurn<DenseHashTable>();
+	testChurn<RobinHoodHashTable>();
+	puts("- done");
+
+	puts("- hash join");
+	testHashJoin();
+	puts("- done");
+
+	puts("- hash functions");
+	testHashFunctions();
+	puts("- done");
+
+	puts("- parallel resize");
+	testParallelResize<COHashTable>();
+	testParallelResize<OOHashTable>();
+	puts("- done");
+
+	puts("- closed addressing hash table with incremental resize");
+	testTable<IncrementalCOHashTable>();
+	puts("- done");
+
+	puts("- slab closed addressing hash table");
+	testTable<SlabHashTable>();
+	puts("- done");
+
 	puts("- open addressing hash table");
 	testTable<OOHashTable>();
 	puts("- done");
 
+	puts("- group probing open addressing hash table");
+	testTable<GroupHashTable>();
+	puts("- done");
+
+	puts("- structure of arrays open addressing hash table");
+	testSoA();
+	puts("- done");
+
+	puts("- dense insertion ordered hash table");
+	testTable<DenseHashTable>();
+	testTransparentFind<DenseHashTable>();
+	testEmplace<DenseHashTable>();
+	testDenseOrder();
+	puts("- done");
+
+	puts("- cuckoo hash table");
+	testTable<CuckooHashTable>();
+	assert(cuckooGrowLoad(200000, 10000) > 0.9f);
+	puts("- done");
+
+	puts("- robin hood open addressing hash table");
+	testTable<RobinHoodHashTable>();
+	puts("- done");
+
 	puts("press enter to exit");
 	getchar();
 }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+
+/// Define HASH_TABLE_STATS before including the tables to count operations, probes and resizes.
+/// Without it the counting statements are removed by the preprocessor and the tables have no extra members,
+/// stats() then reports only what can be computed by walking the table.
+#ifdef HASH_TABLE_STATS
+#define HASH_TABLE_COUNT(statement) statement
+#else
+#define HASH_TABLE_COUNT(statement)
+#endif
+
+
+/// Counter that lookups can increment from many threads, e.g. find under the shared lock of ConcurrentHashTable
+/// Increments are relaxed atomics, the value is exact once the threads are done; copies take the current value
+struct RelaxedCounter {
+	std::atomic<long long> value{0};
+
+	RelaxedCounter() = default;
+	RelaxedCounter(const RelaxedCounter &other)
+		: value(other.get()) {}
+
+	RelaxedCounter &operator=(const RelaxedCounter &other) {
+		value.store(other.get(), std::memory_order_relaxed);
+		return *this;
+	}
+
+	RelaxedCounter &operator++() {
+		value.fetch_add(1, std::memory_order_relaxed);
+		return *this;
+	}
+
+	RelaxedCounter &operator+=(long long amount) {
+		value.fetch_add(amount, std::memory_order_relaxed);
+		return *this;
+	}
+
+	long long get() const {
+		return value.load(std::memory_order_relaxed);
+	}
+
+	operator long long() const {
+		return get();
+	}
+};
+
+
+/// Counters updated by the table operations, only present with HASH_TABLE_STATS
+/// The ones updated by lookups are atomic since lookups may run concurrently, the rest only change under exclusive access
+struct HashTableCounters {
+	RelaxedCounter finds; ///< Lookups by key, including the ones in find_batch
+	RelaxedCounter findHits; ///< Lookups that found the key
+	long long inserts = 0; ///< Calls that could add a key: insert, emplace, operator[], ...
+	long long erases = 0; ///< Erased elements
+	RelaxedCounter probes; ///< Buckets (open addressing) or elements (closed addressing) compared with a key
+	int resizes = 0; ///< Number of times the table grew
+	double rehashMs = 0; ///< Time spent moving elements to a new table, for incremental resize only the first step
+
+	/// Time in milliseconds, used to measure the rehash time
+	static double nowMs() {
+		using namespace std::chrono;
+		return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+	}
+};
+
+
+/// Snapshot of the state of a table returned by stats()
+struct HashTableStats {
+	int size = 0; ///< Number of key-value pairs
+	int buckets = 0; ///< Number of buckets
+	int tombstones = 0; ///< Deleted buckets still in the table, 0 for closed addressing
+	int longestChain = 0; ///< Most comparisons needed to find a present key
+	/// probeHistogram[i] is the number of keys found with exactly i + 1 comparisons
+	/// for closed addressing this is the position in the bucket, for open addressing the distance from the first bucket
+	std::vector<int> probeHistogram;
+
+	bool counted = false; ///< True if the table was compiled with HASH_TABLE_STATS and counters are valid
+	HashTableCounters counters; ///< Operation counters
+
+	/// Average comparisons to find a present key
+	double averageProbe() const {
+		long long total = 0;
+		for (int c = 0; c < int(probeHistogram.size()); c++) {
+			total += (c + 1) * (long long)probeHistogram[c];
+		}
+		return size ? double(total) / size : 0;
+	}
+
+	/// Add one key found after probe comparisons
+	void addProbe(int probe) {
+		if (int(probeHistogram.size()) < probe) {
+			probeHistogram.resize(probe, 0);
+		}
+		++probeHistogram[probe - 1];
+		if (probe > longestChain) {
+			longestChain = probe;
+		}
+	}
+
+	/// Print all stats in human readable form
+	void print(FILE *out = stdout) const {
+		fprintf(out, "  size %d, buckets %d, load %.3f, tombstones %d\n", size, buckets, buckets ? double(size) / buckets : 0, tombstones);
+		fprintf(out, "  longest chain %d, average probe %.3f\n", longestChain, averageProbe());
+		fprintf(out, "  probe histogram:");
+		for (int c = 0; c < int(probeHistogram.size()); c++) {
+			if (probeHistogram[c]) {
+				fprintf(out, " %d:%d", c + 1, probeHistogram[c]);
+			}
+		}
+		fprintf(out, "\n");
+		if (!counted) {
+			fprintf(out, "  operation counters compiled out, build with -DHASH_TABLE_STATS\n");
+			return;
+		}
+		fprintf(out, "  finds %lld (hits %lld), inserts %lld, erases %lld, probes %lld\n",
+			counters.finds.get(), counters.findHits.get(), counters.inserts, counters.erases, counters.probes.get());
+		fprintf(out, "  resizes %d, rehash time %.3f ms\n", counters.resizes, counters.rehashMs);
+	}
+};
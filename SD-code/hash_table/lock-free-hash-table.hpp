@@ -0,0 +1,271 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+
+/// Lock free open addressing hash table with int keys and values, uses linear probing
+/// Every slot is a key word and a value word, both only change with CAS. Keys are never removed,
+/// which fits counter maps and lets probing stop on the first empty slot.
+/// When the table gets half full a table twice the size is linked after it and every writer copies
+/// a chunk of slots before its own operation. A copied slot is frozen (MOVED bit) in the old table,
+/// so writes can't get lost. Readers never write and never wait, they follow frozen slots to the next table.
+/// Old tables are kept until the table is destroyed, since a reader could still be probing them.
+class LockFreeIntHashTable {
+	/// Key word: 0 for empty slot, keyFull | key for used slot or keyMoved for empty slot closed by resize
+	static constexpr uint64_t keyFull = 1ull << 32;
+	static constexpr uint64_t keyMoved = 1ull << 33;
+
+	/// Value word: 0 before first write, valuePresent | value after it, valueMoved is added when the slot is frozen
+	static constexpr uint64_t valuePresent = 1ull << 32;
+	static constexpr uint64_t valueMoved = 1ull << 33;
+
+	/// Slots copied by one writer at a time when helping with a resize
+	static constexpr int copyChunk = 1024;
+
+	struct Slot {
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> value;
+
+		Slot(): key(0), value(0) {}
+	};
+
+	struct Table {
+		const int capacity; ///< Number of slots, power of 2
+		std::unique_ptr<Slot[]> slots; ///< The slots
+		std::atomic<int> used; ///< Number of slots with a key
+		std::atomic<Table *> next; ///< Larger table the elements are copied to, nullptr if not resizing
+		std::atomic<int> copyIndex; ///< First slot not yet claimed for copy
+		std::atomic<int> copied; ///< Number of slots already copied
+
+		Table(int capacity)
+			: capacity(capacity)
+			, slots(new Slot[capacity])
+			, used(0)
+			, next(nullptr)
+			, copyIndex(0)
+			, copied(0) {}
+	};
+
+	std::atomic<Table *> root; ///< Table where operations start, the oldest not fully copied table
+	Table *first; ///< The first table ever allocated, all others are reachable through next
+	std::atomic<int> count; ///< Number of keys with value
+
+	/// Get the first slot index for a key, the key is mixed since std::hash<int> is the identity
+	static int getIndex(int key, int capacity) {
+		const uint64_t hash = uint64_t(uint32_t(key)) * 0x9E3779B97F4A7C15ull;
+		return int(hash >> 32) & (capacity - 1);
+	}
+
+	static uint64_t makeKey(int key) {
+		return keyFull | uint32_t(key);
+	}
+
+	static int getValue(uint64_t value) {
+		return int(uint32_t(value));
+	}
+
+	/// Link a new table after t if there isn't one already and return it
+	Table *startResize(Table *t) {
+		Table *next = t->next.load();
+		if (next) {
+			return next;
+		}
+		Table *newTable = new Table(t->capacity * 2);
+		if (t->next.compare_exchange_strong(next, newTable)) {
+			return newTable;
+		}
+		// other thread started the resize first, next now holds its table
+		delete newTable;
+		return next;
+	}
+
+	/// Freeze the slot so no more writes land in t and copy its value to the next table if it has one
+	void copySlot(Table *t, Slot &slot) {
+		uint64_t key = slot.key.load();
+		while (key == 0) {
+			// close the empty slot so no key can be added here anymore
+			if (slot.key.compare_exchange_weak(key, keyMoved)) {
+				return;
+			}
+		}
+		if (key == keyMoved) {
+			return;
+		}
+
+		uint64_t value = slot.value.load();
+		while (!(value & valueMoved) && !slot.value.compare_exchange_weak(value, value | valueMoved)) {}
+
+		if (value & valuePresent) {
+			// put only if absent, all writers for this key in the next table do the same copy first
+			// so the copy is always the first value there and later updates build on it
+			const uint64_t frozen = valuePresent | uint32_t(value);
+			update(t->next.load(), getValue(key), [frozen](uint64_t current) {
+				return (current & valuePresent) ? current : frozen;
+			});
+		}
+	}
+
+	/// Copy one chunk of t to the next table, the last thread to finish a chunk promotes the next table to root
+	void helpCopy(Table *t) {
+		// don't keep counting after the copy is done
+		if (t->copyIndex.load() >= t->capacity) {
+			return;
+		}
+		const int start = t->copyIndex.fetch_add(copyChunk);
+		if (start >= t->capacity) {
+			return;
+		}
+		const int end = start + copyChunk < t->capacity ? start + copyChunk : t->capacity;
+		for (int c = start; c < end; c++) {
+			copySlot(t, t->slots[c]);
+		}
+		if (t->copied.fetch_add(end - start) + (end - start) == t->capacity) {
+			Table *expected = t;
+			root.compare_exchange_strong(expected, t->next.load());
+		}
+	}
+
+	/// Find the slot for key and replace its value word with apply(value word), starting from table t
+	/// apply must return a value word with valuePresent set, returns the previous value word
+	template <typename Apply>
+	uint64_t update(Table *t, int key, Apply apply) {
+		const uint64_t keyWord = makeKey(key);
+
+		while (true) {
+			if (t->next.load()) {
+				helpCopy(t);
+			}
+
+			const int mask = t->capacity - 1;
+			int idx = getIndex(key, t->capacity);
+			bool moveOn = false;
+
+			for (int probe = 0; probe < t->capacity && !moveOn; ) {
+				Slot &slot = t->slots[idx];
+				uint64_t current = slot.key.load();
+
+				if (current == 0) {
+					const bool resizing = t->next.load() || t->used.load() >= t->capacity / 2;
+					// key is not in t, during resize new keys go to the next table only
+					const uint64_t desired = resizing ? keyMoved : keyWord;
+					if (resizing) {
+						startResize(t);
+					}
+					if (!slot.key.compare_exchange_strong(current, desired)) {
+						continue; // some other thread took the slot, check it again
+					}
+					if (resizing) {
+						moveOn = true;
+						continue;
+					}
+					t->used.fetch_add(1);
+					current = keyWord;
+				}
+
+				if (current == keyMoved) {
+					moveOn = true;
+				} else if (current == keyWord) {
+					uint64_t value = slot.value.load();
+					while (!(value & valueMoved)) {
+						if (slot.value.compare_exchange_weak(value, apply(value))) {
+							return value;
+						}
+					}
+					// frozen slot, make sure the value is in the next table before updating it there
+					copySlot(t, slot);
+					moveOn = true;
+				} else {
+					idx = (idx + 1) & mask;
+					++probe;
+				}
+			}
+
+			// either moved or probed the whole table
+			t = startResize(t);
+		}
+	}
+
+	/// Lookup starting from table t, frozen slots continue in the next table
+	bool findFrom(Table *t, int key, int &value) const {
+		const uint64_t keyWord = makeKey(key);
+		for (; t; t = t->next.load()) {
+			const int mask = t->capacity - 1;
+			int idx = getIndex(key, t->capacity);
+			bool moveOn = false;
+			for (int probe = 0; probe < t->capacity && !moveOn; probe++, idx = (idx + 1) & mask) {
+				const Slot &slot = t->slots[idx];
+				const uint64_t current = slot.key.load();
+				if (current == 0) {
+					return false;
+				}
+				if (current == keyMoved) {
+					moveOn = true;
+				} else if (current == keyWord) {
+					const uint64_t word = slot.value.load();
+					if ((word & valueMoved) && findFrom(t->next.load(), key, value)) {
+						return true;
+					}
+					value = getValue(word);
+					return (word & valuePresent) != 0;
+				}
+			}
+		}
+		return false;
+	}
+public:
+	LockFreeIntHashTable(int initialCapacity = 64)
+		: count(0) {
+		int capacity = 16;
+		while (capacity < initialCapacity) {
+			capacity *= 2;
+		}
+		first = new Table(capacity);
+		root.store(first);
+	}
+
+	LockFreeIntHashTable(const LockFreeIntHashTable &) = delete;
+	LockFreeIntHashTable & operator=(const LockFreeIntHashTable &) = delete;
+
+	~LockFreeIntHashTable() {
+		Table *t = first;
+		while (t) {
+			Table *next = t->next.load();
+			delete t;
+			t = next;
+		}
+	}
+
+	/// Get the value for a key in value, returns false if key is not in the table
+	bool find(int key, int &value) const {
+		return findFrom(root.load(), key, value);
+	}
+
+	/// Set the value for key, inserting key if missing
+	void insert(int key, int value) {
+		const uint64_t word = valuePresent | uint32_t(value);
+		const uint64_t previous = update(root.load(), key, [word](uint64_t) { return word; });
+		if (!(previous & valuePresent)) {
+			count.fetch_add(1);
+		}
+	}
+
+	/// Atomically add delta to the value for key, missing keys start from 0, returns the new value
+	int add(int key, int delta) {
+		const uint64_t previous = update(root.load(), key, [delta](uint64_t current) {
+			const int value = (current & valuePresent) ? getValue(current) : 0;
+			return valuePresent | uint32_t(value + delta);
+		});
+		if (!(previous & valuePresent)) {
+			count.fetch_add(1);
+		}
+		return ((previous & valuePresent) ? getValue(previous) : 0) + delta;
+	}
+
+	/// Get the number of keys in the table, exact only if there are no concurrent inserts
+	int size() const {
+		return count.load();
+	}
+
+};
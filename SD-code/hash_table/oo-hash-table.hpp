@@ -1,18 +1,34 @@
 #pragma once
 
+#include "prefetch.hpp"
+#include "hash-table-stats.hpp"
+#include "hash-snapshot.hpp"
+#include "hash-functions.hpp"
+#include "parallel-for.hpp"
+
 #include <vector>
+#include <atomic>
+#include <algorithm>
 #include <unordered_map>
 #include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
 
 struct LinearProber {
 	int operator() (int index, int size) const {
-		return (index + 1) % size;
+		// compare instead of % size, the table size is not known at compile time so % would divide
+		return index + 1 == size ? 0 : index + 1;
 	}
 };
 
 
 /// Open addressing hash table, templated by key, value, hash functor and function for probing on collision
 /// Also the IndexProbe must not have fixed point
+/// Each bucket keeps the full hash of its key, so resize does not call the hasher and probing compares keys only on hash match
+/// If Hash has is_transparent member type, find also accepts any type the hasher and K can compare with
+/// The number of buckets is always power of 2 and the first bucket is picked with fibonacciIndex
 template <typename K, typename T, typename Hash = std::hash<K>, typename IndexProbe = LinearProber>
 class OOHashTable
 {
@@ -27,6 +43,7 @@ private:
 	
 	struct Bucket {
 		pair_type data; ///< Key value pair
+		size_t hash = 0; ///< Cached hasher(data.first)
 		bool empty = true; ///< true for empty or deleted buckets
 		bool deleted = false; ///< true when element was removed - can be re-used in insert
 	};
@@ -34,58 +51,180 @@ private:
 	typedef std::vector<Bucket> table_t;
 	typedef typename table_t::iterator bucket_iterator;
 
+	static constexpr int minBits = 5; ///< log2 of the smallest and initial number of buckets
+
 	table_t table; ///< The table data
+	int bits; ///< table.size() == 1 << bits
 	int count; ///< Actual number of elements
+	int tombstones; ///< Number of deleted buckets, they don't end probe sequences so they count towards the load
+	float maxLoad; ///< Table grows when the load factor reaches this
+	int resizeThreads; ///< Threads moving the elements when the table is re-hashed
 	Hash hasher; ///< The hash functor
+#ifdef HASH_TABLE_STATS
+	HashTableCounters counters; ///< Operation counters reported by stats()
+#endif
 	IndexProbe nextIndex; ///< Functor to access next index
 
-	/// Get the initial bucket index for a given key
-	int getIndex(const K& key) const {
-		return hasher(key) % table.size();
+	/// Get the initial bucket index for a given hash
+	int getIndex(size_t hash) const {
+		return fibonacciIndex(hash, bits);
 	}
 
-	/// Check if the table needs to be resized
+	/// Check if the table needs to be resized, tombstones count as used buckets
+	/// otherwise insert and erase churn fills every empty bucket without a resize and probing never ends
 	bool needsResize() const {
-		const float factor = float(count) / table.size();
-		return factor >= 0.7;
+		const float factor = float(count + tombstones) / table.size();
+		return factor >= maxLoad;
+	}
+
+	/// Smallest log2 of bucket count that holds n used buckets, elements and tombstones, below the max load factor
+	int bitsFor(long long n) const {
+		int result = minBits;
+		while (double(n) >= double(1ll << result) * maxLoad) {
+			++result;
+		}
+		return result;
 	}
 
-	/// Resize and re-hash the table
+	/// Double the table size, or re-hash with the same size if it is mostly tombstones
+	/// After either one at most half of the max load is used, so the next resize is at least that many inserts away
 	void resize() {
-		table_t newTable(table.size() * 2 + 1);
+		rehashTo(std::max(bits, bitsFor(2ll * count)));
+	}
+
+	/// Move all elements to a new table of 2^newBits buckets, this also drops all tombstones
+	void rehashTo(int newBits) {
+		HASH_TABLE_COUNT(const double rehashStart = HashTableCounters::nowMs());
+		HASH_TABLE_COUNT(++counters.resizes);
+		table_t newTable(size_t(1) << newBits);
 		// swap with member so we can re-use insert
 		newTable.swap(table);
+		bits = newBits;
+		tombstones = 0;
+
+		if (resizeThreads > 1 && int(newTable.size()) >= parallelResizeMinBuckets) {
+			parallelRehash(newTable);
+			HASH_TABLE_COUNT(counters.rehashMs += HashTableCounters::nowMs() - rehashStart);
+			return;
+		}
 
 		// since insert is re-used, it will increment count for each element
 		// thus zero it here so the end count is correct
 		count = 0;
 		for (Bucket & el : newTable) {
 			if (!el.empty && !el.deleted) {
-				// re-use insert to avoid duplicating the collision logic
-				insert(el.data.first, el.data.second);
+				// keys are unique so just take the first free bucket, the hash is already known
+				bucket_iterator bucket = findFreeBucket(el.hash);
+				bucket->data = std::move(el.data);
+				bucket->hash = el.hash;
+				bucket->empty = false;
+				++count;
 			}
 		}
+		HASH_TABLE_COUNT(counters.rehashMs += HashTableCounters::nowMs() - rehashStart);
+	}
+
+	/// Move all elements of source into the empty current table with resizeThreads threads, each one takes a range of source
+	/// Probe sequences cross the ranges, so destination buckets are claimed with an atomic flag per bucket:
+	/// an element takes the first bucket on its sequence that no other element claimed, same as findFreeBucket,
+	/// and claims are never released, so every element is reachable from its first bucket without an empty bucket in between
+	void parallelRehash(table_t &source) {
+		std::vector<std::atomic<bool>> claimed(table.size());
+		parallelRanges(resizeThreads, int(source.size()), 1, [this, &source, &claimed](int from, int to) {
+			for (int c = from; c < to; c++) {
+				Bucket &el = source[c];
+				if (el.empty) {
+					continue;
+				}
+				int idx = getIndex(el.hash);
+				// read before exchange, so claimed buckets don't bounce between the caches
+				while (claimed[idx].load(std::memory_order_relaxed) || claimed[idx].exchange(true, std::memory_order_relaxed)) {
+					idx = getNextIndex(idx);
+				}
+				// the bucket is written only by the thread that claimed it, and joining the threads publishes it
+				Bucket &bucket = table[idx];
+				bucket.data = std::move(el.data);
+				bucket.hash = el.hash;
+				bucket.empty = false;
+			}
+		});
 	}
 
 	/// Convenience wrapper over the nextIndex template
-	int getNextIndex(int index) {
+	int getNextIndex(int index) const {
 		return nextIndex(index, table.size());
 	}
 
-	/// Find the correct bucket for a given key
+	/// Find the first empty bucket for a given hash, used only when the key is known to be missing
+	bucket_iterator findFreeBucket(size_t hash) {
+		int idx = getIndex(hash);
+		while (!table[idx].empty) {
+			idx = getNextIndex(idx);
+		}
+		return table.begin() + idx;
+	}
+
+	/// Find the bucket holding the key or, if it is missing, the bucket it should be inserted in -
+	/// the first deleted bucket on its probe sequence or the empty bucket ending it
+	/// Returned bucket is empty only if the key is missing, probes the sequence once and at most table.size() buckets
+	template <typename Key>
+	bucket_iterator findInsertBucket(const Key &key, size_t hash, int idx) {
+		int freeIdx = -1;
+		for (int probes = 0; probes < int(table.size()); probes++) {
+			HASH_TABLE_COUNT(++counters.probes);
+			const Bucket &bucket = table[idx];
+			if (bucket.empty) {
+				// a deleted bucket before the key must not stop the search, otherwise the key is inserted twice
+				if (!bucket.deleted) {
+					return table.begin() + (freeIdx == -1 ? idx : freeIdx);
+				}
+				if (freeIdx == -1) {
+					freeIdx = idx;
+				}
+			} else if (bucket.hash == hash && bucket.data.first == key) {
+				return table.begin() + idx;
+			}
+			idx = getNextIndex(idx);
+		}
+		// every bucket was probed and none is empty, count is below the bucket count so at least one of them is deleted
+		assert(freeIdx != -1);
+		return table.begin() + freeIdx;
+	}
+
+	/// Assign value constructed from the arguments, a single argument is assigned directly if possible so there is no temporary
+	static void assignValue(T &value) {
+		value = T();
+	}
+
+	template <typename Arg>
+	static void assignValue(T &value, Arg &&arg) {
+		if constexpr (std::is_assignable<T &, Arg &&>::value) {
+			value = std::forward<Arg>(arg);
+		} else {
+			value = T(std::forward<Arg>(arg));
+		}
+	}
+
+	template <typename First, typename Second, typename... Rest>
+	static void assignValue(T &value, First &&first, Second &&second, Rest &&...rest) {
+		value = T(std::forward<First>(first), std::forward<Second>(second), std::forward<Rest>(rest)...);
+	}
+
+	/// Find the correct bucket for a given key, its hash and the initial index getIndex(hash)
 	/// If checkDeleted is set, then finds non deleted buckets
 	/// If nextIndex is guaranteed to walk every index then this will always terminate eventually
-	bucket_iterator findBucket(const K &key, bool checkDeleted) {
-		int idx = getIndex(key);
+	template <typename Key>
+	bucket_iterator findBucket(const Key &key, size_t hash, int idx, bool checkDeleted) {
 
 		// do endless loop and move checks inside to improve readability
 		while (true) {
+			HASH_TABLE_COUNT(++counters.probes);
 			// can stop on free bucket
 			if (table[idx].empty && (!checkDeleted || checkDeleted && !table[idx].deleted)) {
 				break;
 			}
 			// key could match by might be deleted
-			if (table[idx].data.first == key && (!checkDeleted || checkDeleted && !table[idx].deleted)) {
+			if (table[idx].hash == hash && table[idx].data.first == key && (!checkDeleted || checkDeleted && !table[idx].deleted)) {
 				break;
 			}
 			idx = getNextIndex(idx);
@@ -96,8 +235,12 @@ private:
 	
 public:
 	OOHashTable(Hash hash = Hash(), IndexProbe probe = IndexProbe())
-		: table(41)
+		: table(size_t(1) << minBits)
+		, bits(minBits)
 		, count(0)
+		, tombstones(0)
+		, maxLoad(0.7f)
+		, resizeThreads(1)
 		, hasher(hash)
 		, nextIndex(probe) {}
 
@@ -174,21 +317,62 @@ public:
 		return iterator(table, table.end());
 	}
 
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
 	iterator insert(const K &key, const T&value) {
-		if (needsResize()) {
-			resize();
-		}
+		return insertOrAssign(key, value);
+	}
 
-		bucket_iterator bucket = findBucket(key, false); // ignore deleted flag when inserting
-		assert(!bucket->empty || bucket->empty ^ bucket->deleted);
-		if (bucket->empty) {
-			++count;
+	/// Same as insert, but the key and value are moved into the table instead of copied
+	iterator insert(K &&key, T &&value) {
+		return insertOrAssign(std::move(key), std::move(value));
+	}
+
+	iterator insert(const K &key, T &&value) {
+		return insertOrAssign(key, std::move(value));
+	}
+
+	iterator insert(K &&key, const T &value) {
+		return insertOrAssign(std::move(key), value);
+	}
+
+	/// If key is missing insert it with value constructed from args, otherwise do nothing
+	/// Returns iterator to the element for key and true if it was inserted, args are not used if key is present
+	/// The buckets always hold constructed pairs, so the value is assigned from args, not constructed
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+		return tryEmplace(key, std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(K &&key, Args &&...args) {
+		return tryEmplace(std::move(key), std::forward<Args>(args)...);
+	}
+
+	/// Construct key-value pair from args and insert it if the key is missing, the value is not overwritten
+	/// The pair is constructed before the lookup, prefer try_emplace when the key is available
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args &&...args) {
+		pair_type item(std::forward<Args>(args)...);
+		return tryEmplace(std::move(item.first), std::move(item.second));
+	}
+
+	/// Insert all key-value pairs, same as insert for each one, but with the buckets prefetched ahead
+	void insert_batch(const std::vector<pair_type> &items) {
+		HASH_TABLE_COUNT(counters.inserts += items.size());
+		// resize for the whole batch before starting, so the prefetched buckets stay valid
+		reserve(count + items.size());
+
+		std::vector<size_t> hashes(items.size());
+		std::vector<int> indices(items.size());
+		for (int c = 0; c < int(items.size()); c++) {
+			hashes[c] = hasher(items[c].first);
+			indices[c] = getIndex(hashes[c]);
 		}
-		bucket->deleted = false;
-		bucket->empty = false;
-		bucket->data = std::make_pair(key, value);
 
-		return iterator(table, bucket);
+		for (int c = 0; c < int(items.size()); c++) {
+			prefetchBucket(indices, c);
+			insertHashed(items[c].first, items[c].second, hashes[c], indices[c]);
+		}
 	}
 
 	/// Erase an item and return iterator to the next valid item or end()
@@ -197,9 +381,11 @@ public:
 		if (it == end()) {
 			return it;
 		}
-		assert(!it.element->empty || it.element->empty ^ it.element->deleted);
+		assert(!it.element->deleted || it.element->empty);
 		if (!it.element->empty) {
 			--count;
+			++tombstones;
+			HASH_TABLE_COUNT(++counters.erases);
 			it.element->deleted = it.element->empty = true;
 		}
 
@@ -214,31 +400,263 @@ public:
 
 	/// Get iterator for a given key or end() if key is not inserted
 	iterator find(const K &key) {
-		bucket_iterator bucket = findBucket(key, true); // must not be deleted
-		assert(!bucket->empty || bucket->empty ^ bucket->deleted);
-		if (bucket->empty) {
-			return end();
+		const size_t hash = hasher(key);
+		iterator it = findHashed(key, hash, getIndex(hash));
+		HASH_TABLE_COUNT(countFind(it));
+		return it;
+	}
+
+	/// Find an element by any key type that can be hashed and compared with K, only for transparent Hash
+	/// e.g. std::string_view or const char * with StringHash, does not construct K
+	template <typename Key, typename H = Hash, typename = typename H::is_transparent>
+	iterator find(const Key &key) {
+		const size_t hash = hasher(key);
+		iterator it = findHashed(key, hash, getIndex(hash));
+		HASH_TABLE_COUNT(countFind(it));
+		return it;
+	}
+
+	/// Find all keys, result[i] is the iterator for keys[i] or end()
+	/// All keys are hashed first and the buckets are prefetched ahead, so the cache misses overlap
+	void find_batch(const std::vector<K> &keys, std::vector<iterator> &result) {
+		std::vector<size_t> hashes(keys.size());
+		std::vector<int> indices(keys.size());
+		for (int c = 0; c < int(keys.size()); c++) {
+			hashes[c] = hasher(keys[c]);
+			indices[c] = getIndex(hashes[c]);
+		}
+
+		result.clear();
+		result.reserve(keys.size());
+		for (int c = 0; c < int(keys.size()); c++) {
+			prefetchBucket(indices, c);
+			result.push_back(findHashed(keys[c], hashes[c], indices[c]));
+			HASH_TABLE_COUNT(countFind(result.back()));
 		}
-		return iterator(table, bucket);
 	}
 
 	/// Get reference to a based on a key, if not present insert default constructed value
+	/// Probes the table only once
 	T & operator[](const K&key) {
-		if (float(count) / table.size() > 0.7) {
-			resize();
-		}
+		return tryEmplace(key).first->second;
+	}
 
-		iterator element = find(key);
-		if (element != end()) {
-			assert(!element.element->empty || element.element->empty ^ element.element->deleted);
-			return element->second;
-		}
-		
-		return insert(key, T())->second;
+	T & operator[](K &&key) {
+		return tryEmplace(std::move(key)).first->second;
 	}
 
 	/// Get the number of key-value pairs in the map
 	int size() const {
 		return count;
 	}
+
+	/// Get the number of buckets, always power of 2
+	int bucket_count() const {
+		return int(table.size());
+	}
+
+	/// Move the elements with up to threads threads when the table is re-hashed, tables below parallelResizeMinBuckets use one thread
+	/// With more than one thread the buckets an element ends up in depend on timing, but lookups are not affected
+	void setResizeThreads(int threads) {
+		resizeThreads = std::max(1, threads);
+	}
+
+	/// Get the load factor at which the table grows
+	float max_load_factor() const {
+		return maxLoad;
+	}
+
+	/// Set the load factor at which the table grows, must be in (0, 1) since probing needs an empty bucket
+	/// If the table is already above it, it grows right away
+	void max_load_factor(float factor) {
+		assert(factor > 0 && factor < 1);
+		maxLoad = factor;
+		reserve(count);
+	}
+
+	/// Make room for n elements, so inserting up to n elements in total does not resize the table
+	/// New elements can take empty buckets while the tombstones stay, so the tombstones need room too,
+	/// unless the table is re-hashed which drops them, possibly at the same size
+	void reserve(long long n) {
+		if (bitsFor(n + tombstones) > bits) {
+			rehashTo(std::max(bits, bitsFor(n)));
+		}
+	}
+
+	/// Re-hash to at least buckets buckets (rounded up to power of 2) and enough for size() elements, can also shrink
+	/// The re-hash removes all tombstones, even if the bucket count does not change
+	void rehash(int buckets) {
+		int newBits = bitsFor(count);
+		while ((1ll << newBits) < buckets) {
+			++newBits;
+		}
+		rehashTo(newBits);
+	}
+
+	/// Shrink the table to the smallest size that holds the current elements below the max load factor
+	void shrink_to_fit() {
+		rehash(0);
+	}
+
+	/// Get probe histogram, longest probe and tombstones by walking the table, and the operation counters if compiled with HASH_TABLE_STATS
+	HashTableStats stats() const {
+		HashTableStats result;
+		result.size = count;
+		result.buckets = int(table.size());
+		for (int c = 0; c < int(table.size()); c++) {
+			if (table[c].deleted) {
+				++result.tombstones;
+			} else if (!table[c].empty) {
+				// walk the probe sequence from the first bucket, since IndexProbe is not always linear
+				int probe = 1;
+				for (int idx = getIndex(table[c].hash); idx != c; idx = getNextIndex(idx)) {
+					++probe;
+				}
+				result.addProbe(probe);
+			}
+		}
+#ifdef HASH_TABLE_STATS
+		result.counted = true;
+		result.counters = counters;
+#endif
+		return result;
+	}
+
+	/// Read only view returned by open_snapshot
+	typedef OOHashSnapshot<K, T, Hash, IndexProbe> snapshot_type;
+
+	/// Write the table to path as flat image that open_snapshot can map without rebuilding the table
+	/// Only for trivially copyable keys and values, returns false if the file can't be written
+	bool save_snapshot(const char *path) const {
+		static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<T>::value,
+			"snapshot needs trivially copyable key and value");
+		typedef SnapshotFormat::Slot<K, T> slot_type;
+
+		SnapshotFormat::Header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SnapshotFormat::magic, sizeof(header.magic));
+		header.keySize = sizeof(K);
+		header.valueSize = sizeof(T);
+		header.slotSize = sizeof(slot_type);
+		header.bucketCount = uint32_t(table.size());
+		header.count = count;
+		header.controlOffset = sizeof(header);
+		const uint64_t controlEnd = header.controlOffset + table.size();
+		header.slotOffset = (controlEnd + SnapshotFormat::slotAlign - 1) / SnapshotFormat::slotAlign * SnapshotFormat::slotAlign;
+		header.fileSize = header.slotOffset + table.size() * sizeof(slot_type);
+
+		std::vector<uint8_t> control(header.slotOffset - header.controlOffset, SnapshotFormat::empty);
+		std::vector<slot_type> slots(table.size());
+		// zero the empty slots and the padding so the file does not depend on old memory contents
+		memset(static_cast<void *>(slots.data()), 0, slots.size() * sizeof(slot_type));
+		for (int c = 0; c < int(table.size()); c++) {
+			const Bucket &bucket = table[c];
+			if (bucket.deleted) {
+				control[c] = SnapshotFormat::deleted;
+			} else if (!bucket.empty) {
+				control[c] = SnapshotFormat::tag(bucket.hash);
+				memcpy(static_cast<void *>(&slots[c].key), &bucket.data.first, sizeof(K));
+				memcpy(static_cast<void *>(&slots[c].value), &bucket.data.second, sizeof(T));
+			}
+		}
+
+		FILE *file = fopen(path, "wb");
+		if (!file) {
+			return false;
+		}
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written = written && fwrite(control.data(), 1, control.size(), file) == control.size();
+		written = written && fwrite(slots.data(), sizeof(slot_type), slots.size(), file) == slots.size();
+		return fclose(file) == 0 && written;
+	}
+
+	/// Map a snapshot written by save_snapshot, check isOpen() on the result
+	/// The hash and probe must give the same results as the ones of the table that wrote it
+	static snapshot_type open_snapshot(const char *path, Hash hash = Hash(), IndexProbe probe = IndexProbe()) {
+		snapshot_type snapshot(hash, probe);
+		snapshot.open(path);
+		return snapshot;
+	}
+
+private:
+	/// Prefetch the first bucket for the key batchPrefetchDistance ahead of idx
+	void prefetchBucket(const std::vector<int> &indices, int idx) {
+		const int ahead = idx + batchPrefetchDistance;
+		if (ahead < int(indices.size())) {
+			prefetch(&table[indices[ahead]]);
+		}
+	}
+
+	/// Resize if needed and insert or overwrite, KeyArg and ValueArg are K and T references
+	template <typename KeyArg, typename ValueArg>
+	iterator insertOrAssign(KeyArg &&key, ValueArg &&value) {
+		HASH_TABLE_COUNT(++counters.inserts);
+		if (needsResize()) {
+			resize();
+		}
+
+		const size_t hash = hasher(key);
+		return insertHashed(std::forward<KeyArg>(key), std::forward<ValueArg>(value), hash, getIndex(hash));
+	}
+
+	/// Resize if needed and insert value constructed from args only if key is missing
+	template <typename KeyArg, typename... Args>
+	std::pair<iterator, bool> tryEmplace(KeyArg &&key, Args &&...args) {
+		HASH_TABLE_COUNT(++counters.inserts);
+		if (needsResize()) {
+			resize();
+		}
+
+		const size_t hash = hasher(key);
+		bucket_iterator bucket = findInsertBucket(key, hash, getIndex(hash));
+		if (!bucket->empty) {
+			return std::make_pair(iterator(table, bucket), false);
+		}
+		fill(bucket, std::forward<KeyArg>(key), hash, std::forward<Args>(args)...);
+		return std::make_pair(iterator(table, bucket), true);
+	}
+
+	/// Insert key with known hash and initial index, table must already be resized if needed
+	template <typename KeyArg, typename ValueArg>
+	iterator insertHashed(KeyArg &&key, ValueArg &&value, size_t hash, int idx) {
+		bucket_iterator bucket = findInsertBucket(key, hash, idx);
+		if (bucket->empty) {
+			fill(bucket, std::forward<KeyArg>(key), hash, std::forward<ValueArg>(value));
+		} else {
+			bucket->data.second = std::forward<ValueArg>(value);
+		}
+		return iterator(table, bucket);
+	}
+
+	/// Put a key known to be missing in the free bucket returned by findInsertBucket
+	template <typename KeyArg, typename... Args>
+	void fill(bucket_iterator bucket, KeyArg &&key, size_t hash, Args &&...args) {
+		assert(bucket->empty);
+		++count;
+		tombstones -= bucket->deleted;
+		bucket->deleted = false;
+		bucket->empty = false;
+		bucket->hash = hash;
+		bucket->data.first = std::forward<KeyArg>(key);
+		assignValue(bucket->data.second, std::forward<Args>(args)...);
+	}
+
+#ifdef HASH_TABLE_STATS
+	/// Count one lookup by key
+	void countFind(const iterator &it) {
+		++counters.finds;
+		counters.findHits += it != end();
+	}
+#endif
+
+	/// Find implementation for both K and transparent key types with known hash and initial index
+	template <typename Key>
+	iterator findHashed(const Key &key, size_t hash, int idx) {
+		bucket_iterator bucket = findBucket(key, hash, idx, true); // must not be deleted
+		assert(!bucket->deleted || bucket->empty);
+		if (bucket->empty) {
+			return end();
+		}
+		return iterator(table, bucket);
+	}
 };
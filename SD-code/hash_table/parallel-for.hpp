@@ -0,0 +1,32 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+
+/// Tables with fewer buckets than this always resize on one thread, starting threads costs more than moving them
+const int parallelResizeMinBuckets = 1 << 16;
+
+/// Split [0, count) in up to threads contiguous ranges and call body(from, to) for each one on its own thread
+/// Every range except the last starts and ends on a multiple of align
+/// The calling thread runs the first range, a std::thread is started for each of the others and all are joined before returning.
+/// There is no pool, threads are created per call, which is fine for rare and long operations like resizing a large table
+template <typename Body>
+void parallelRanges(int threads, int count, int align, Body body) {
+	const int blocks = (count + align - 1) / align;
+	threads = std::max(1, std::min(threads, blocks));
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (int t = 1; t < threads; t++) {
+		const int from = int((long long)blocks * t / threads) * align;
+		const int to = std::min(count, int((long long)blocks * (t + 1) / threads) * align);
+		workers.emplace_back([&body, from, to]() {
+			body(from, to);
+		});
+	}
+	body(0, std::min(count, int((long long)blocks / threads) * align));
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+/// Number of keys the batched operations prefetch ahead of the one being resolved
+const int batchPrefetchDistance = 16;
+
+/// Hint the CPU to start loading the cache line of address, never faults
+inline void prefetch(const void *address) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+
+
+/// Open addressing hash table with Robin Hood insertion, templated by key, value and hash functor
+/// Every bucket stores the distance from its home index. Insert takes the bucket from elements that are
+/// closer to their home, which keeps all probe lengths close to the average and lets lookups for
+/// missing keys stop early. Erase shifts the following elements back, so no tombstones are left.
+/// The table does not wrap around, there is extra space after the last home index instead,
+/// this way erase never moves an element before the position of an iterator.
+template <typename K, typename T, typename Hash = std::hash<K>>
+class RobinHoodHashTable
+{
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef K key_type;
+	typedef T value_type;
+
+	typedef value_type & reference;
+private:
+
+	struct Bucket {
+		pair_type data; ///< Key value pair
+		int distance = -1; ///< Distance from the home index of the key, -1 for empty buckets
+	};
+
+	typedef std::vector<Bucket> table_t;
+	typedef typename table_t::iterator bucket_iterator;
+
+	table_t table; ///< The table data, home indices are only in [0, capacity)
+	int capacity; ///< Number of home indices
+	int count; ///< Actual number of elements
+	Hash hasher; ///< The hash functor
+
+	/// Get the home bucket index for a given key
+	int getIndex(const K &key) const {
+		return hasher(key) % capacity;
+	}
+
+	/// Check if the table needs to be resized
+	bool needsResize() const {
+		const float factor = float(count) / capacity;
+		return factor >= 0.85;
+	}
+
+	/// Number of buckets after the last home index, long probes past it will trigger resize
+	static int overflowSize(int capacity) {
+		int log = 0;
+		while ((1 << log) < capacity) {
+			++log;
+		}
+		return log * 2 + 8;
+	}
+
+	/// Resize and re-hash the table
+	void resize() {
+		const int newCapacity = capacity * 2 + 1;
+		table_t newTable(newCapacity + overflowSize(newCapacity));
+		// swap with member so we can re-use place
+		newTable.swap(table);
+		capacity = newCapacity;
+
+		for (Bucket &el : newTable) {
+			if (el.distance != -1) {
+				place(std::move(el.data));
+			}
+		}
+	}
+
+	/// Find the bucket holding the key or -1 if the key is not in the table
+	int findIndex(const K &key) const {
+		int idx = getIndex(key);
+		for (int distance = 0; idx < int(table.size()); ++distance, ++idx) {
+			// any element here is closer to its home than the key would be, key can't be further
+			if (table[idx].distance < distance) {
+				return -1;
+			}
+			if (table[idx].distance == distance && table[idx].data.first == key) {
+				return idx;
+			}
+		}
+		return -1;
+	}
+
+	/// Put a key that is not present in the table and return the index where it ended up
+	/// Resizes the table if the probe sequence reaches the end of the overflow area
+	int place(pair_type &&element) {
+		pair_type carry = std::move(element);
+		int idx = getIndex(carry.first);
+		int distance = 0;
+		int result = -1; ///< Where the new element ended up, -1 while it is still carried
+
+		for (; idx < int(table.size()); ++distance, ++idx) {
+			Bucket &bucket = table[idx];
+			if (bucket.distance == -1) {
+				bucket.data = std::move(carry);
+				bucket.distance = distance;
+				return result == -1 ? idx : result;
+			}
+			// take the bucket of an element that is closer to its home and continue with it
+			if (bucket.distance < distance) {
+				std::swap(bucket.data, carry);
+				std::swap(bucket.distance, distance);
+				if (result == -1) {
+					result = idx;
+				}
+			}
+		}
+
+		// ran out of overflow area, grow the table and retry with the element that is still carried
+		if (result == -1) {
+			resize();
+			return place(std::move(carry));
+		}
+
+		// the new element is already placed, but its index changes after resize
+		const K key = table[result].data.first;
+		resize();
+		place(std::move(carry));
+		return findIndex(key);
+	}
+
+public:
+	RobinHoodHashTable(Hash hash = Hash())
+		: table(41 + overflowSize(41))
+		, capacity(41)
+		, count(0)
+		, hasher(hash) {}
+
+	/// Iterator over the key-value pairs in the table
+	class iterator {
+		friend class RobinHoodHashTable;
+		table_t *table; ///< Pointer to the table, not reference so the class can have operator=
+		bucket_iterator element; ///< Iterator to the element
+
+		/// Construct from some table and iterator and move to the first valid element or the end() iterator
+		iterator(table_t &table, bucket_iterator el)
+			: table(&table)
+			, element(el)
+		{
+			validateIterator();
+		}
+
+		/// If the current iterator points to empty bucket move it forward until end() or valid bucket
+		void validateIterator() {
+			while (element != table->end() && element->distance == -1) {
+				++element;
+			}
+		}
+	public:
+		/// Pair with const first element so key can be immutable to the user of the iterator
+		typedef std::pair<const K, T> const_pair;
+
+		/// Get reference to the key value pair
+		const_pair & operator*() {
+			// same binary layout, key must be const so callers can't break the table invariants
+			// data is the first member, so cast the bucket itself like OOHashTable does, casting the member breaks strict aliasing
+			return reinterpret_cast<const_pair &>(*element);
+		}
+
+		/// Pointer to the key-value pair
+		const_pair * operator->() {
+			return &(operator*());
+		}
+
+		/// Prefix increment
+		iterator& operator++() {
+			++element;
+			validateIterator();
+			return *this;
+		}
+
+		/// Postfix increment
+		iterator operator++(int) {
+			iterator copy(*this);
+			++element;
+			validateIterator();
+			return copy;
+		}
+
+		/// Equality check, iterators must be from the same table
+		bool operator==(const iterator &other) const {
+			return table == other.table && element == other.element;
+		}
+
+		/// Opposite of operator==
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// First valid key-value pair or end() if table is empty
+	iterator begin() {
+		return iterator(table, table.begin());
+	}
+
+	/// End iterator can be used only for equality checks
+	iterator end() {
+		return iterator(table, table.end());
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	iterator insert(const K &key, const T &value) {
+		if (needsResize()) {
+			resize();
+		}
+
+		int idx = findIndex(key);
+		if (idx != -1) {
+			table[idx].data.second = value;
+			return iterator(table, table.begin() + idx);
+		}
+
+		++count;
+		idx = place(std::make_pair(key, value));
+		return iterator(table, table.begin() + idx);
+	}
+
+	/// Erase an item and return iterator to the next valid item or end()
+	iterator erase(iterator it) {
+		// check for end erase(find(somKey)) works as expected
+		if (it == end()) {
+			return it;
+		}
+		assert(it.element->distance != -1);
+		--count;
+
+		// shift back all following elements that are not in their home bucket
+		int idx = int(it.element - table.begin());
+		while (idx + 1 < int(table.size()) && table[idx + 1].distance > 0) {
+			table[idx].data = std::move(table[idx + 1].data);
+			table[idx].distance = table[idx + 1].distance - 1;
+			++idx;
+		}
+		table[idx].data = pair_type();
+		table[idx].distance = -1;
+
+		// element at the iterator position (if any) was moved from after it, so it is not yet visited
+		it.validateIterator();
+		return it;
+	}
+
+	/// Erase element by key and return iterator to next element in map or end()
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get iterator for a given key or end() if key is not inserted
+	iterator find(const K &key) {
+		const int idx = findIndex(key);
+		if (idx == -1) {
+			return end();
+		}
+		return iterator(table, table.begin() + idx);
+	}
+
+	/// Get reference to a based on a key, if not present insert default constructed value
+	T & operator[](const K &key) {
+		iterator element = find(key);
+		if (element != end()) {
+			return element->second;
+		}
+
+		return insert(key, T())->second;
+	}
+
+	/// Get the number of key-value pairs in the map
+	int size() const {
+		return count;
+	}
+
+	/// Average distance of the elements from their home bucket, 0 for empty table
+	double averageProbeLength() const {
+		long long total = 0;
+		for (const Bucket &bucket : table) {
+			if (bucket.distance != -1) {
+				total += bucket.distance;
+			}
+		}
+		return count ? double(total) / count : 0;
+	}
+
+	/// Longest distance of an element from its home bucket
+	int maxProbeLength() const {
+		int longest = 0;
+		for (const Bucket &bucket : table) {
+			longest = std::max(longest, bucket.distance);
+		}
+		return longest;
+	}
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+
+
+/// Closed addressing hash table, templated by key, value and hash of key
+/// Same as COHashTable, but the entries live in fixed size slabs and the chains are 32 bit indices into them.
+/// A new slab is allocated once per slabSize inserts, erased entries go in a free list and are re-used.
+/// Entries never move, so resize only re-links the indices and never copies keys or values.
+/// It is a separate class and not a storage parameter of COHashTable, since the iterator, incremental and parallel resize
+/// and find_batch of COHashTable all walk std::vector buckets, and ConcurrentHashTable relies on those paths.
+template <typename K, typename T, typename Hash = std::hash<K>>
+class SlabHashTable {
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef T value_type;
+	typedef K key_type;
+
+	typedef value_type & reference;
+private:
+	static constexpr uint32_t nil = UINT32_MAX; ///< End of chain or empty free list
+	static constexpr int slabBits = 10;
+	static constexpr uint32_t slabSize = 1 << slabBits; ///< Entries in one slab
+
+	struct Entry {
+		pair_type data; ///< Key value pair
+		uint32_t next = nil; ///< Next entry in the chain or in the free list
+	};
+
+	std::vector<std::unique_ptr<Entry[]>> slabs; ///< Storage for all entries, slab pointers never change
+	uint32_t allocated; ///< Number of entries ever taken from the slabs
+	uint32_t freeList; ///< First erased entry that can be re-used
+	std::vector<uint32_t> table; ///< First entry of each bucket
+	int count; ///< Number of elements inserted in the table
+	Hash hasher; ///< Hasher object
+
+	/// Get the entry for a given index
+	Entry & entry(uint32_t idx) {
+		return slabs[idx >> slabBits][idx & (slabSize - 1)];
+	}
+
+	/// Get the bucket index for a given key
+	int index(const K &key) const {
+		return hasher(key) % table.size();
+	}
+
+	/// Check if table has reached maxLoadFactor
+	bool shouldResize() {
+		const float load = float(count) / table.size();
+		return load > 0.7;
+	}
+
+	/// Allocate bigger bucket array and re-link all entries into it
+	void resize() {
+		std::vector<uint32_t> oldTable(table.size() * 2 + 1, nil);
+		// swap the tables now so index() uses the new size
+		table.swap(oldTable);
+
+		for (uint32_t head : oldTable) {
+			while (head != nil) {
+				Entry &el = entry(head);
+				const uint32_t next = el.next;
+				uint32_t &bucket = table[index(el.data.first)];
+				el.next = bucket;
+				bucket = head;
+				head = next;
+			}
+		}
+	}
+
+	/// Get index of unused entry, from the free list or from the slabs
+	uint32_t allocate() {
+		if (freeList != nil) {
+			const uint32_t idx = freeList;
+			freeList = entry(idx).next;
+			return idx;
+		}
+		if (allocated == slabs.size() * slabSize) {
+			slabs.emplace_back(new Entry[slabSize]);
+		}
+		return allocated++;
+	}
+
+	/// Find the entry with key in the given bucket or nil
+	uint32_t findInBucket(int bucket, const K &key) {
+		for (uint32_t idx = table[bucket]; idx != nil; idx = entry(idx).next) {
+			if (entry(idx).data.first == key) {
+				return idx;
+			}
+		}
+		return nil;
+	}
+
+public:
+	SlabHashTable(Hash hasher = Hash())
+		: allocated(0)
+		, freeList(nil)
+		, table(32, nil)
+		, count(0)
+		, hasher(hasher) {
+	}
+
+	void clear() {
+		slabs.clear();
+		allocated = 0;
+		freeList = nil;
+		table.assign(32, nil);
+		count = 0;
+	}
+
+	class iterator {
+		// friend the container so it can access the private constructors
+		friend class SlabHashTable;
+
+		SlabHashTable *table; ///< Pointer so the iterators can be easily copy-able
+		int bucket; ///< Index of the current bucket
+		uint32_t element; ///< Index of the current entry, nil only for end()
+
+		/// Creates iterator to a specific entry, if element is nil move to the first entry of the next buckets
+		iterator(SlabHashTable &table, int bucket, uint32_t element)
+			: table(&table)
+			, bucket(bucket)
+			, element(element)
+		{
+			findNextValid();
+		}
+
+	public:
+		/// Pair with const first element so key can be immutable to the user of the iterator
+		typedef std::pair<const K, T> const_pair;
+
+		/// Get pair, but cast it to const key, so caller can't edit the key
+		const_pair & operator*() const {
+			// we can safely reinterpret this as they are binary the same
+			return reinterpret_cast<const_pair &>(table->entry(element));
+		}
+
+		const_pair * operator->() const {
+			// re-use the operator* to avoid writing the cast
+			return &(operator*());
+		}
+
+		iterator operator++(int) {
+			iterator copy(*this);
+			advance();
+			return copy;
+		}
+
+		iterator& operator++() {
+			advance();
+			return *this;
+		}
+
+		bool operator==(const iterator &other) const {
+			return table == other.table && bucket == other.bucket && element == other.element;
+		}
+
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		/// Assuming iterator points to valid element, advance it to the next valid
+		/// or to the end() iterator position
+		void advance() {
+			element = table->entry(element).next;
+			findNextValid();
+		}
+
+		/// If element is nil, find the first entry of the next non empty bucket or get to end()
+		void findNextValid() {
+			const int size = int(table->table.size());
+			while (element == nil && bucket < size) {
+				++bucket;
+				if (bucket < size) {
+					element = table->table[bucket];
+				}
+			}
+		}
+	};
+
+	/// Iterator to first element or end() if table is empty
+	iterator begin() {
+		return iterator(*this, 0, table[0]);
+	}
+
+	/// End iterator, can only be used for equality check
+	iterator end() {
+		return iterator(*this, int(table.size()), nil);
+	}
+
+	/// Find an element by its key, returns iterator to the element or end() if not found
+	iterator find(const K &key) {
+		const int bucket = index(key);
+		const uint32_t idx = findInBucket(bucket, key);
+		if (idx == nil) {
+			return end();
+		}
+		return iterator(*this, bucket, idx);
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	iterator insert(const K &key, const T &value) {
+		// do check before inserting as it can invalidate iterators!
+		if (shouldResize()) {
+			resize();
+		}
+
+		const int bucket = index(key);
+		uint32_t idx = findInBucket(bucket, key);
+		if (idx != nil) {
+			entry(idx).data.second = value;
+			return iterator(*this, bucket, idx);
+		}
+
+		++count;
+		idx = allocate();
+		Entry &el = entry(idx);
+		el.data.first = key;
+		el.data.second = value;
+		el.next = table[bucket];
+		table[bucket] = idx;
+		return iterator(*this, bucket, idx);
+	}
+
+	/// Get value reference to an element with given key,
+	/// if key is not in the table, default construct the value and insert it
+	reference operator[](const K &key) {
+		iterator it = find(key);
+		if (it == end()) {
+			return insert(key, T())->second;
+		} else {
+			return it->second;
+		}
+	}
+
+	/// Erase the element pointed by the iterator and return iterator to the next element
+	iterator erase(iterator it) {
+		// do this check so the table can support this: table.erase(table.find(someKey));
+		if (it == end()) {
+			return it;
+		}
+
+		// unlink from the chain, the chains are single linked so find the previous entry
+		Entry &el = entry(it.element);
+		const uint32_t next = el.next;
+		if (table[it.bucket] == it.element) {
+			table[it.bucket] = next;
+		} else {
+			uint32_t prev = table[it.bucket];
+			while (entry(prev).next != it.element) {
+				prev = entry(prev).next;
+			}
+			entry(prev).next = next;
+		}
+
+		// release any resources held by the key and value and put the entry in the free list
+		el.data = pair_type();
+		el.next = freeList;
+		freeList = it.element;
+		--count;
+
+		return iterator(*this, it.bucket, next);
+	}
+
+	/// Erase item by key, returns iterator to next valid element
+	/// If key is not in the map, return end() iterator
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get the number of key-value pairs in the table
+	int size() const {
+		return count;
+	}
+};
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "oo-hash-table.hpp"
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+
+/// Open addressing hash table with the same probing as OOHashTable, but structure of arrays layout:
+/// keys, values and metadata (cached hash and flags) are in three separate arrays with one entry per bucket.
+/// Probing reads only metadata and keys, the value is touched once on a hit, so large values
+/// don't take cache space during the probe. Small values pay one extra cache miss per hit instead.
+/// There is no std::pair in memory, so iterators return a pair of references instead of a pair reference.
+template <typename K, typename T, typename Hash = std::hash<K>, typename IndexProbe = LinearProber>
+class SoAHashTable
+{
+public:
+	typedef std::pair<K, T> pair_type;
+
+	typedef K key_type;
+	typedef T value_type;
+
+	typedef value_type & reference;
+private:
+
+	struct Meta {
+		size_t hash = 0; ///< Cached hasher(key)
+		bool empty = true; ///< true for empty or deleted buckets
+		bool deleted = false; ///< true when element was removed - can be re-used in insert
+	};
+
+	std::vector<Meta> meta; ///< Flags and hashes of the buckets
+	std::vector<K> keys; ///< Keys, valid only for full buckets
+	std::vector<T> values; ///< Values, valid only for full buckets
+	int count; ///< Actual number of elements
+	int tombstones; ///< Number of deleted buckets, they don't end probe sequences so they count towards the load
+	Hash hasher; ///< The hash functor
+	IndexProbe nextIndex; ///< Functor to access next index
+
+	/// Get the initial bucket index for a given hash
+	int getIndex(size_t hash) const {
+		return hash % meta.size();
+	}
+
+	/// Convenience wrapper over the nextIndex template
+	int getNextIndex(int index) const {
+		return nextIndex(index, int(meta.size()));
+	}
+
+	/// Check if the table needs to be resized, tombstones count as used buckets
+	/// otherwise insert and erase churn fills every empty bucket without a resize and probing never ends
+	bool needsResize() const {
+		const float factor = float(count + tombstones) / meta.size();
+		return factor >= 0.7;
+	}
+
+	/// Find the first empty bucket for a given hash, used only when the key is known to be missing
+	int findFreeBucket(size_t hash) const {
+		int idx = getIndex(hash);
+		while (!meta[idx].empty) {
+			idx = getNextIndex(idx);
+		}
+		return idx;
+	}
+
+	/// Find the bucket with the key or the empty bucket that ends its probe sequence, deleted buckets are skipped
+	int findBucket(const K &key, size_t hash) const {
+		int idx = getIndex(hash);
+		while (true) {
+			const Meta &m = meta[idx];
+			if (m.empty) {
+				if (!m.deleted) {
+					return idx;
+				}
+			} else if (m.hash == hash && keys[idx] == key) {
+				return idx;
+			}
+			idx = getNextIndex(idx);
+		}
+	}
+
+	/// Resize and re-hash the table, keys and values are moved, if mostly tombstones are present re-hash with the same size
+	void resize() {
+		const int newSize = count * 2 < int(meta.size()) ? int(meta.size()) : int(meta.size()) * 2 + 1;
+		std::vector<Meta> oldMeta(newSize);
+		std::vector<K> oldKeys(newSize);
+		std::vector<T> oldValues(newSize);
+		// swap with members so we can re-use findFreeBucket
+		oldMeta.swap(meta);
+		oldKeys.swap(keys);
+		oldValues.swap(values);
+		tombstones = 0;
+
+		for (int c = 0; c < int(oldMeta.size()); c++) {
+			if (!oldMeta[c].empty) {
+				// keys are unique so just take the first free bucket, the hash is already known
+				const int idx = findFreeBucket(oldMeta[c].hash);
+				meta[idx].hash = oldMeta[c].hash;
+				meta[idx].empty = false;
+				keys[idx] = std::move(oldKeys[c]);
+				values[idx] = std::move(oldValues[c]);
+			}
+		}
+	}
+
+public:
+	SoAHashTable(Hash hash = Hash(), IndexProbe probe = IndexProbe())
+		: meta(41)
+		, keys(41)
+		, values(41)
+		, count(0)
+		, tombstones(0)
+		, hasher(hash)
+		, nextIndex(probe) {}
+
+	/// Iterator over the key-value pairs in the table
+	class iterator {
+		friend class SoAHashTable;
+		SoAHashTable *table; ///< Pointer to the table, not reference so the class can have operator=
+		int index; ///< Index of the bucket
+
+		/// Construct from some table and bucket index and move to the first valid element or the end() iterator
+		iterator(SoAHashTable &table, int index)
+			: table(&table)
+			, index(index)
+		{
+			validateIterator();
+		}
+
+		/// If the current iterator points to empty bucket move it forward until end() or valid bucket
+		void validateIterator() {
+			while (index < int(table->meta.size()) && table->meta[index].empty) {
+				++index;
+			}
+		}
+	public:
+		/// References to the key and the value, key is const so it can't be changed by the user of the iterator
+		struct const_pair {
+			const K &first;
+			T &second;
+		};
+
+		/// Holds the const_pair so operator-> can return a pointer to it
+		struct pointer {
+			const_pair pair;
+
+			const_pair * operator->() {
+				return &pair;
+			}
+		};
+
+		/// Get references to the key and value
+		const_pair operator*() const {
+			return const_pair{table->keys[index], table->values[index]};
+		}
+
+		/// Access the key-value pair
+		pointer operator->() const {
+			return pointer{operator*()};
+		}
+
+		/// Prefix increment
+		iterator& operator++() {
+			++index;
+			validateIterator();
+			return *this;
+		}
+
+		/// Postfix increment
+		iterator operator++(int) {
+			iterator copy(*this);
+			++index;
+			validateIterator();
+			return copy;
+		}
+
+		/// Equality check, iterators must be from the same table
+		bool operator==(const iterator &other) const {
+			return table == other.table && index == other.index;
+		}
+
+		/// Opposite of operator==
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/// First valid key-value pair or end() if table is empty
+	iterator begin() {
+		return iterator(*this, 0);
+	}
+
+	/// End iterator can be used only for equality checks
+	iterator end() {
+		return iterator(*this, int(meta.size()));
+	}
+
+	/// Insert key-value pair, if key is already present in the table, overwrites the value
+	iterator insert(const K &key, const T &value) {
+		if (needsResize()) {
+			resize();
+		}
+
+		const size_t hash = hasher(key);
+		int idx = findBucket(key, hash);
+		if (meta[idx].empty) {
+			// key is missing, re-use the first deleted or empty bucket
+			idx = findFreeBucket(hash);
+		}
+		Meta &m = meta[idx];
+		assert(!m.deleted || m.empty);
+		if (m.empty) {
+			++count;
+			tombstones -= m.deleted;
+			keys[idx] = key;
+		}
+		m.deleted = false;
+		m.empty = false;
+		m.hash = hash;
+		values[idx] = value;
+
+		return iterator(*this, idx);
+	}
+
+	/// Erase an item and return iterator to the next valid item or end()
+	iterator erase(iterator it) {
+		// check for end erase(find(somKey)) works as expected
+		if (it == end()) {
+			return it;
+		}
+		Meta &m = meta[it.index];
+		assert(!m.deleted || m.empty);
+		if (!m.empty) {
+			--count;
+			++tombstones;
+			m.deleted = m.empty = true;
+			// release any resources held by the key and value
+			keys[it.index] = K();
+			values[it.index] = T();
+		}
+
+		it.validateIterator();
+		return it;
+	}
+
+	/// Erase element by key and return iterator to next element in map or end()
+	iterator erase(const K &key) {
+		return erase(find(key));
+	}
+
+	/// Get iterator for a given key or end() if key is not inserted
+	iterator find(const K &key) {
+		const int idx = findBucket(key, hasher(key));
+		if (meta[idx].empty) {
+			return end();
+		}
+		return iterator(*this, idx);
+	}
+
+	/// Get reference to a based on a key, if not present insert default constructed value
+	T & operator[](const K &key) {
+		iterator element = find(key);
+		if (element != end()) {
+			return values[element.index];
+		}
+
+		return values[insert(key, T()).index];
+	}
+
+	/// Get the number of key-value pairs in the map
+	int size() const {
+		return count;
+	}
+};
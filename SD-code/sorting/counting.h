@@ -1,36 +1,105 @@
+#pragma once
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <chrono>
+
+#include "radix.h"
 
 static const int maxCountRange = 1024 * 1024;
 
-void countingSort(std::vector<int> &data) {
+/// Each thread gets at least this many elements, below it starting threads costs more than counting
+static const int minCountPerThread = 1 << 16;
+
+/// Write size copies of value starting at target, 4 at a time with SSE2
+inline void fillRun(int *target, int size, int value) {
+	int c = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128i values = _mm_set1_epi32(value);
+	for (; c + 4 <= size; c += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(target + c), values);
+	}
+#endif
+	for (; c < size; c++) {
+		target[c] = value;
+	}
+}
+
+/// Counting sort on up to threads threads, falls back to Base256 radix sort when the range is above maxCountRange
+/// Each thread counts its slice of the data into its own histogram, the histograms are merged once and then each thread
+/// writes an equal slice of the output with the runs of values that fall in it.
+/// Threads are also limited so all histograms together are not larger than the data, since merging them costs range per thread
+void countingSort(std::vector<int> &data, int threads = 1) {
 	if (data.size() < 2) {
 		return;
 	}
-	const std::pair<std::vector<int>::iterator, std::vector<int>::iterator> minmax = std::minmax_element(data.begin(), data.end());
-	const int range = *minmax.second - *minmax.first + 1;
+	const int n = data.size();
+	threads = std::max(1, std::min(threads, n / minCountPerThread));
+
+	std::vector<int> threadMin(threads, INT_MAX), threadMax(threads, INT_MIN);
+	Base256::runThreads(threads, [&](int t) {
+		const std::pair<std::vector<int>::iterator, std::vector<int>::iterator> minmax =
+			std::minmax_element(data.begin() + (long long)n * t / threads, data.begin() + (long long)n * (t + 1) / threads);
+		threadMin[t] = *minmax.first;
+		threadMax[t] = *minmax.second;
+	});
+	const int minValue = *std::min_element(threadMin.begin(), threadMin.end());
+	const int maxValue = *std::max_element(threadMax.begin(), threadMax.end());
 
-	if (range > maxCountRange) {
-		std::sort(data.begin(), data.end());
+	if ((long long)maxValue - minValue + 1 > maxCountRange) {
+		if (threads > 1) {
+			Base256::parallelRadixSort256(data, threads);
+		} else {
+			Base256::radixSort256(data);
+		}
 		return;
 	}
 
-	const int offset = *minmax.first;
-	std::vector<int> counts(range, 0);
-	for (int c = 0; c < data.size(); c++) {
-		counts[data[c] - offset]++;
-	}
+	const int range = maxValue - minValue + 1;
+	const int offset = minValue;
+	const int histograms = std::max(1, std::min(threads, n / range));
+	std::vector<std::vector<int>> counts(histograms, std::vector<int>(range, 0));
+	Base256::runThreads(histograms, [&](int t) {
+		int *count = counts[t].data();
+		const int to = int((long long)n * (t + 1) / histograms);
+		for (int c = int((long long)n * t / histograms); c < to; c++) {
+			count[data[c] - offset]++;
+		}
+	});
 
-	int out = 0;
-	for (int c = 0; c < counts.size(); c++) {
-		for (int r = 0; r < counts[c]; r++) {
-			data[out++] = c + offset;
+	// merge into counts[0] split by value, then turn it into the start of each run, starts[range] == n
+	std::vector<int> &merged = counts[0];
+	Base256::runThreads(histograms, [&](int t) {
+		const int to = int((long long)range * (t + 1) / histograms);
+		for (int v = int((long long)range * t / histograms); v < to; v++) {
+			for (int h = 1; h < histograms; h++) {
+				merged[v] += counts[h][v];
+			}
 		}
+	});
+	std::vector<int> starts(range + 1);
+	starts[0] = 0;
+	for (int v = 0; v < range; v++) {
+		starts[v + 1] = starts[v] + merged[v];
 	}
+
+	Base256::runThreads(threads, [&](int t) {
+		const int from = int((long long)n * t / threads);
+		const int to = int((long long)n * (t + 1) / threads);
+		// the run that contains from is the last one starting at or before it
+		int v = int(std::upper_bound(starts.begin(), starts.end(), from) - starts.begin()) - 1;
+		for (int position = from; position < to; v++) {
+			const int end = std::min(to, starts[v + 1]);
+			fillRun(data.data() + position, end - position, v + offset);
+			position = end;
+		}
+	});
 }
 
-void test(std::mt19937 &generator, int size) {
+void testCountingSortSize(std::mt19937 &generator, int size) {
 	std::vector<int> mine;
 	mine.reserve(size);
 
@@ -52,7 +121,59 @@ void testCountingSort(int maxElements = 10000) {
 	std::mt19937 generator(42);
 	for (int c = 1; c < maxElements; c++) {
 		for (int r = 0; r < 10; r++) {
-			test(generator, c);
+			testCountingSortSize(generator, c);
+		}
+	}
+}
+
+/// Compare the multi-threaded countingSort with std::sort for small ranges, ranges near the histogram limit and the radix fallback
+void testParallelCountingSort() {
+	std::mt19937 generator(42);
+	const int sizes[] = {1000, minCountPerThread * 3 + 17, 1000000};
+	const int ranges[] = {1, 7, 256, 100000, maxCountRange, maxCountRange + 1, INT_MAX};
+	for (int size : sizes) {
+		for (int range : ranges) {
+			for (int threads : {1, 2, 3, 8}) {
+				std::uniform_int_distribution<int> dist(range == INT_MAX ? INT_MIN : -range / 2, range == INT_MAX ? INT_MAX : range - 1 - range / 2);
+				std::vector<int> mine(size);
+				for (int &value : mine) {
+					value = dist(generator);
+				}
+				std::vector<int> copy = mine;
+				std::sort(copy.begin(), copy.end());
+				countingSort(mine, threads);
+				if (mine != copy) {
+					__debugbreak();
+					assert(false);
+				}
+			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+/// Time countingSort with 1 to maxThreads threads against std::sort for small key ranges and one that takes the radix fallback
+void benchmarkCountingSort(int size = 50000000, int maxThreads = 8) {
+	using namespace std::chrono;
+	std::mt19937 generator(42);
+	for (int range : {5, 256, 65536, 1 << 30}) {
+		std::uniform_int_distribution<int> dist(0, range - 1);
+		std::vector<int> original(size);
+		for (int &value : original) {
+			value = dist(generator);
+		}
+
+		std::vector<int> copy = original;
+		steady_clock::time_point start = steady_clock::now();
+		std::sort(copy.begin(), copy.end());
+		printf("range %d, %d elements: std::sort %.1f ms\n", range, size, duration<double, std::milli>(steady_clock::now() - start).count());
+
+		for (int threads = 1; threads <= maxThreads; threads *= 2) {
+			std::vector<int> data = original;
+			start = steady_clock::now();
+			countingSort(data, threads);
+			const double elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+			assert(data == copy);
+			printf("%2d threads: countingSort %.1f ms\n", threads, elapsed);
+		}
+	}
+}
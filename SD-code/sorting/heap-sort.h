@@ -2,6 +2,14 @@
 #include <utility>
 #include <random>
 #include <cassert>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <new>
+#include <cstddef>
+#include <cstdio>
+#include <chrono>
 
 /// Join two heaps with the element that is parent for both
 /// NOTE: also called siftDown/heapifyDown to push the element at the top to the appropriate place
@@ -135,8 +143,205 @@ void heapSort(int *data, int size) {
 	}
 }
 
+/// Join value into the d-ary heap [0, size) at the empty spot hole, the children of node i are [i * Arity + 1, i * Arity + Arity]
+/// Uses Floyd's bottom-up strategy: the hole first goes down to a leaf always taking the larger child, without comparing
+/// with value, then value is pushed up from there. Value usually belongs near the bottom, so this saves the comparison with it
+/// on every level on the way down, at the price of a few on the way up
+/// @param data - the array holding the heap
+/// @param size - the number of items in the heap
+/// @param hole - index of the spot to fill, both it's subtrees must be heaps
+/// @param value - the element to put in the heap
+/// @param compare - less than comparator, the largest element is on top
+template <int Arity, typename T, typename Compare>
+void siftDownFloyd(T *data, int size, int hole, T value, Compare compare) {
+	const int start = hole;
+	while (true) {
+		const int first = hole * Arity + 1;
+		if (first >= size) {
+			break;
+		}
+		int best = first;
+		if (first + Arity <= size) {
+			// full group of children, constant trip count so the compiler can unroll it
+			// a branch is better than a select here: the processor guesses the larger child and starts loading its
+			// children before the comparison is done, with a select every level waits for the previous one
+			for (int c = 1; c < Arity; c++) {
+				if (compare(data[best], data[first + c])) {
+					best = first + c;
+				}
+			}
+		} else {
+			for (int c = first + 1; c < size; c++) {
+				if (compare(data[best], data[c])) {
+					best = c;
+				}
+			}
+		}
+		data[hole] = std::move(data[best]);
+		hole = best;
+	}
 
-void test(std::mt19937 &generator, int size) {
+	while (hole > start) {
+		const int parent = (hole - 1) / Arity;
+		if (!compare(data[parent], value)) {
+			break;
+		}
+		data[hole] = std::move(data[parent]);
+		hole = parent;
+	}
+	data[hole] = std::move(value);
+}
+
+/// Push the last item in the d-ary heap, items in range [0, last) must already be heap
+/// @param data - the data
+/// @param last - the index of the element to push into the heap
+/// @param compare - less than comparator
+template <int Arity, typename T, typename Compare>
+void siftUpDary(T *data, int last, Compare compare) {
+	int current = last;
+	T value = std::move(data[current]);
+	while (current > 0) {
+		const int parent = (current - 1) / Arity;
+		if (!compare(data[parent], value)) {
+			break;
+		}
+		data[current] = std::move(data[parent]);
+		current = parent;
+	}
+	data[current] = std::move(value);
+}
+
+/// Make d-ary heap in-place using bottom-up strategy
+/// @param data - the array
+/// @param size - the number of items in the array
+/// @param compare - less than comparator
+template <int Arity, typename T, typename Compare>
+void makeDaryHeap(T *data, int size, Compare compare) {
+	for (int c = (size - 2) / Arity; c >= 0 && size > 1; c--) {
+		siftDownFloyd<Arity>(data, size, c, std::move(data[c]), compare);
+	}
+}
+
+/// Move the top of the d-ary heap to data[size - 1] and make [0, size - 1) a heap, like std::pop_heap
+/// @param data - the heap
+/// @param size - the number of items in the heap before the pop
+/// @param compare - less than comparator
+template <int Arity, typename T, typename Compare>
+void popDaryHeap(T *data, int size, Compare compare) {
+	if (size < 2) {
+		return;
+	}
+	T last = std::move(data[size - 1]);
+	data[size - 1] = std::move(data[0]);
+	siftDownFloyd<Arity>(data, size - 1, 0, std::move(last), compare);
+}
+
+/// Use d-ary heap sort to sort the elements in ascending order of compare
+/// With 4 or 8 children per node the heap is 2 or 3 times shallower than the binary one, so each pop touches fewer cache lines
+template <int Arity, typename T, typename Compare = std::less<T>>
+void daryHeapSort(T *data, int size, Compare compare = Compare()) {
+	makeDaryHeap<Arity>(data, size, compare);
+	for (int c = size; c > 1; c--) {
+		popDaryHeap<Arity>(data, c, compare);
+	}
+}
+
+/// Allocator returning memory aligned to a cache line, to control where the children groups of a heap start
+template <typename T>
+struct CacheAlignedAllocator {
+	typedef T value_type;
+	static const size_t alignment = 64;
+
+	CacheAlignedAllocator() = default;
+	template <typename U>
+	CacheAlignedAllocator(const CacheAlignedAllocator<U> &) {}
+
+	T *allocate(size_t count) {
+		return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+	}
+
+	void deallocate(T *ptr, size_t) {
+		::operator delete(ptr, std::align_val_t(alignment));
+	}
+
+	template <typename U>
+	bool operator==(const CacheAlignedAllocator<U> &) const {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const CacheAlignedAllocator<U> &) const {
+		return false;
+	}
+};
+
+/// Priority queue on a d-ary heap with cache aligned children groups, the largest element by Compare is on top
+/// The storage starts on a cache line and the heap starts Arity - 1 items after it, so the children of node i,
+/// at [i * Arity + 1, i * Arity + Arity] in the heap, start at Arity * (i + 1) in the storage.
+/// When Arity * sizeof(T) divides 64 each group is inside one cache line, so picking the largest child costs one miss,
+/// e.g. Arity 4 with 8 byte or Arity 8 with 4 and 8 byte elements. The first Arity - 1 items are default constructed padding
+template <typename T, int Arity = 4, typename Compare = std::less<T>>
+class DaryHeap {
+	static_assert(Arity >= 2, "DaryHeap needs at least 2 children per node");
+	std::vector<T, CacheAlignedAllocator<T>> items; ///< Arity - 1 padding items followed by the heap
+	Compare compare; ///< The less than comparator
+
+	T *heap() {
+		return items.data() + Arity - 1;
+	}
+
+public:
+	DaryHeap(Compare compare = Compare())
+		: items(Arity - 1)
+		, compare(compare) {}
+
+	/// Replace the contents with [first, last) and make them a heap with bottom-up make heap
+	template <typename It>
+	void assign(It first, It last) {
+		items.resize(Arity - 1);
+		items.insert(items.end(), first, last);
+		makeDaryHeap<Arity>(heap(), size(), compare);
+	}
+
+	void push(const T &value) {
+		items.push_back(value);
+		siftUpDary<Arity>(heap(), size() - 1, compare);
+	}
+
+	void push(T &&value) {
+		items.push_back(std::move(value));
+		siftUpDary<Arity>(heap(), size() - 1, compare);
+	}
+
+	/// The largest element, the heap must not be empty
+	const T &top() const {
+		return items[Arity - 1];
+	}
+
+	/// Remove the largest element, the heap must not be empty
+	void pop() {
+		T last = std::move(items.back());
+		items.pop_back();
+		if (!empty()) {
+			siftDownFloyd<Arity>(heap(), size(), 0, std::move(last), compare);
+		}
+	}
+
+	int size() const {
+		return int(items.size()) - (Arity - 1);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	void reserve(int count) {
+		items.reserve(count + Arity - 1);
+	}
+};
+
+
+void testHeapSortSize(std::mt19937 &generator, int size) {
 	std::vector<int> mine;
 	mine.reserve(size);
 	for (int c = 0; c < size; c++) {
@@ -156,7 +361,137 @@ void testHeapSort(int maxElements = 10000) {
 	std::mt19937 generator(42);
 	for (int c = 1; c < maxElements; c++) {
 		for (int r = 0; r < 10; r++) {
-			test(generator, c);
+			testHeapSortSize(generator, c);
+		}
+	}
+}
+
+/// Compare daryHeapSort with std::sort for int and double and a reversed comparator
+template <int Arity>
+void testDaryHeapSort(std::mt19937 &generator, int size) {
+	std::vector<int> mine(size);
+	for (int &value : mine) {
+		value = generator() % (size + 1);
+	}
+	std::vector<double> doubles(mine.begin(), mine.end());
+
+	std::vector<int> copy = mine;
+	std::vector<double> doublesCopy = doubles;
+	std::sort(copy.begin(), copy.end());
+	std::sort(doublesCopy.begin(), doublesCopy.end(), std::greater<double>());
+	daryHeapSort<Arity>(mine.data(), mine.size());
+	daryHeapSort<Arity>(doubles.data(), doubles.size(), std::greater<double>());
+	if (mine != copy || doubles != doublesCopy) {
+		__debugbreak();
+		assert(false);
+	}
+}
+
+/// Random pushes and pops on DaryHeap, checking the top against std::priority_queue after each operation
+template <int Arity>
+void testDaryHeapQueue(std::mt19937 &generator, int operations) {
+	DaryHeap<long long, Arity> mine;
+	std::priority_queue<long long> copy;
+	for (int c = 0; c < operations; c++) {
+		if (copy.empty() || generator() % 3) {
+			const long long value = generator() % 1000;
+			mine.push(value);
+			copy.push(value);
+		} else {
+			mine.pop();
+			copy.pop();
 		}
+		if (mine.size() != int(copy.size()) || (!copy.empty() && mine.top() != copy.top())) {
+			__debugbreak();
+			assert(false);
+		}
+	}
+
+	std::vector<long long> values(operations);
+	for (long long &value : values) {
+		value = generator();
+	}
+	mine.assign(values.begin(), values.end());
+	std::sort(values.begin(), values.end());
+	for (int c = operations - 1; c >= 0; c--) {
+		if (mine.top() != values[c]) {
+			__debugbreak();
+			assert(false);
+		}
+		mine.pop();
+	}
+	assert(mine.empty());
+}
+
+void testDaryHeap(int maxElements = 2000) {
+	std::mt19937 generator(42);
+	for (int c = 0; c < maxElements; c += 3) {
+		testDaryHeapSort<2>(generator, c);
+		testDaryHeapSort<4>(generator, c);
+		testDaryHeapSort<8>(generator, c);
+	}
+	testDaryHeapQueue<2>(generator, 100000);
+	testDaryHeapQueue<4>(generator, 100000);
+	testDaryHeapQueue<8>(generator, 100000);
+}
+
+/// Time a heap sort of copy of data and check the result
+template <typename Sort>
+void timeHeapSort(const char *name, const std::vector<int> &data, const std::vector<int> &sorted, Sort sort) {
+	using namespace std::chrono;
+	std::vector<int> copy = data;
+	const steady_clock::time_point start = steady_clock::now();
+	sort(copy);
+	const double elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+	assert(copy == sorted);
+	printf("%s: %.1f ms\n", name, elapsed);
+}
+
+/// Time pushing all values to Queue and then popping them all
+template <typename Queue>
+void timeQueue(const char *name, const std::vector<long long> &values) {
+	using namespace std::chrono;
+	Queue queue;
+	long long check = 0;
+	const steady_clock::time_point start = steady_clock::now();
+	for (long long value : values) {
+		queue.push(value);
+	}
+	while (!queue.empty()) {
+		check ^= queue.top();
+		queue.pop();
+	}
+	const double elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+	printf("%s: %.1f ms (%lld)\n", name, elapsed, check);
+}
+
+/// Compare the heap sorts on size random ints and the priority queues on size random long longs
+void benchmarkDaryHeap(int size = 10000000) {
+	std::mt19937 generator(42);
+	std::vector<int> data(size);
+	for (int &value : data) {
+		value = generator();
+	}
+	std::vector<int> sorted = data;
+	std::sort(sorted.begin(), sorted.end());
+
+	printf("heap sort of %d ints\n", size);
+	timeHeapSort("heapSort", data, sorted, [](std::vector<int> &values) { heapSort(values.data(), values.size()); });
+	timeHeapSort("std::make_heap + std::sort_heap", data, sorted, [](std::vector<int> &values) {
+		std::make_heap(values.begin(), values.end());
+		std::sort_heap(values.begin(), values.end());
+	});
+	timeHeapSort("daryHeapSort<2>", data, sorted, [](std::vector<int> &values) { daryHeapSort<2>(values.data(), values.size()); });
+	timeHeapSort("daryHeapSort<4>", data, sorted, [](std::vector<int> &values) { daryHeapSort<4>(values.data(), values.size()); });
+	timeHeapSort("daryHeapSort<8>", data, sorted, [](std::vector<int> &values) { daryHeapSort<8>(values.data(), values.size()); });
+
+	std::vector<long long> values(size);
+	for (long long &value : values) {
+		value = ((long long)generator() << 32) | generator();
 	}
+	printf("push and pop %d long longs\n", size);
+	timeQueue<std::priority_queue<long long>>("std::priority_queue", values);
+	timeQueue<DaryHeap<long long, 2>>("DaryHeap<2>", values);
+	timeQueue<DaryHeap<long long, 4>>("DaryHeap<4>", values);
+	timeQueue<DaryHeap<long long, 8>>("DaryHeap<8>", values);
 }
@@ -1,8 +1,22 @@
+#pragma once
 #include <vector>
 #include <type_traits>
 #include <algorithm>
 #include <random>
+#include <limits>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 int powInt(int value, int power) {
 	int product = 1;
@@ -93,6 +107,224 @@ void radixSort10(std::vector<int> &data) {
 
 }
 
+namespace Base256
+{
+
+/// Map key to unsigned integer with the same order, flipping the sign bit puts the negative numbers first
+template <typename T>
+typename std::make_unsigned<T>::type radixKey(T value) {
+	typedef typename std::make_unsigned<T>::type U;
+	if (std::is_signed<T>::value) {
+		return U(value) ^ (U(1) << (sizeof(T) * 8 - 1));
+	}
+	return U(value);
+}
+
+/// Map float to unsigned integer with the same order as the values
+/// Negative numbers have all bits flipped, so larger magnitudes come first, positive numbers only get the sign bit set, so they come after.
+/// -0.0 sorts before +0.0, NaNs with the sign bit clear sort after +inf and the others before -inf
+inline uint32_t radixKey(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+/// Map double to unsigned integer with the same order as the values, see radixKey(float)
+inline uint64_t radixKey(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x8000000000000000ull) ? ~bits : bits | 0x8000000000000000ull;
+}
+
+/// LSD radix sort with 8 bit digits for 32 and 64 bit integers, signed or unsigned, float and double
+/// The histograms of all digits are built in one read pass over the data before any element is moved,
+/// and passes where all keys have the same digit are skipped since they would only copy the data
+/// e.g. 64 bit keys that all fit in 32 bits take 4 passes instead of 8
+template <typename T>
+void radixSort256(std::vector<T> &data) {
+	static_assert(std::is_arithmetic<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "radixSort256 sorts 32 and 64 bit integers, float and double");
+	const int digits = sizeof(T);
+	const int n = data.size();
+	if (n < 2) {
+		return;
+	}
+
+	std::vector<int> counts(digits * 256, 0);
+	for (int c = 0; c < n; c++) {
+		const auto key = radixKey(data[c]);
+		for (int d = 0; d < digits; d++) {
+			++counts[d * 256 + ((key >> (d * 8)) & 0xff)];
+		}
+	}
+
+	std::vector<T> output(n);
+	for (int d = 0; d < digits; d++) {
+		int *count = counts.data() + d * 256;
+		// every key has this digit, the pass would not change the order
+		if (count[(radixKey(data[0]) >> (d * 8)) & 0xff] == n) {
+			continue;
+		}
+
+		// exclusive prefix sum, count[digit] becomes the first output position for that digit
+		int sum = 0;
+		for (int c = 0; c < 256; c++) {
+			const int size = count[c];
+			count[c] = sum;
+			sum += size;
+		}
+
+		for (int c = 0; c < n; c++) {
+			const int digit = (radixKey(data[c]) >> (d * 8)) & 0xff;
+			output[count[digit]++] = data[c];
+		}
+		data.swap(output);
+	}
+}
+
+
+/// Call body(t) for t in [0, threads), each on its own thread, the calling thread runs body(0)
+/// Threads are started for every call, which is cheap compared to a pass over millions of elements
+template <typename Body>
+void runThreads(int threads, Body body) {
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++) {
+		workers.emplace_back(body, t);
+	}
+	body(0);
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+/// Elements of one write combining buffer, one cache line per digit
+template <typename T>
+constexpr int combineSize() {
+	return 64 / sizeof(T);
+}
+
+/// Write the 64 bytes at source to the cache line at target, which must be 64 byte aligned
+/// With SSE2 the line is written with non-temporal stores, so it is not read into the cache first and doesn't evict the input
+inline void streamLine(void *target, const void *source) {
+#if defined(__SSE2__) || defined(_M_X64)
+	__m128i *to = static_cast<__m128i *>(target);
+	const __m128i *from = static_cast<const __m128i *>(source);
+	for (int c = 0; c < 4; c++) {
+		_mm_stream_si128(to + c, _mm_loadu_si128(from + c));
+	}
+#else
+	memcpy(target, source, 64);
+#endif
+}
+
+/// Order the non-temporal stores of streamLine before the stores that come after
+inline void streamFence() {
+#if defined(__SSE2__) || defined(_M_X64)
+	_mm_sfence();
+#endif
+}
+
+/// Parallel version of radixSort256, the data is split in one contiguous chunk per thread
+/// Each pass every thread counts the digits of its chunk, then a prefix sum over all (digit, thread) pairs
+/// gives each thread its own region of the output for every digit, so the threads scatter without synchronization.
+/// Elements are first collected in a cache line buffer per digit and written out a full line at a time with non-temporal stores,
+/// so the scatter touches one line per 64 bytes of output instead of one per element (less cache and TLB misses)
+/// The first read pass counts all digits, so it also finds the passes that can be skipped
+template <typename T>
+void parallelRadixSort256(std::vector<T> &data, int threads) {
+	static_assert(std::is_arithmetic<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "parallelRadixSort256 sorts 32 and 64 bit integers, float and double");
+	const int digits = sizeof(T);
+	const int n = data.size();
+	const int minPerThread = 1 << 14;
+	threads = std::max(1, std::min(threads, n / minPerThread));
+	if (n < 2) {
+		return;
+	}
+
+	// counts[t][d * 256 + digit] - elements of thread t chunk with that digit at position d
+	std::vector<std::vector<int>> counts(threads, std::vector<int>(digits * 256, 0));
+	runThreads(threads, [&](int t) {
+		int *count = counts[t].data();
+		for (int c = int((long long)n * t / threads); c < int((long long)n * (t + 1) / threads); c++) {
+			const auto key = radixKey(data[c]);
+			for (int d = 0; d < digits; d++) {
+				++count[d * 256 + ((key >> (d * 8)) & 0xff)];
+			}
+		}
+	});
+
+	std::vector<T> output(n);
+	bool firstPass = true;
+	for (int d = 0; d < digits; d++) {
+		const int firstDigit = (radixKey(data[0]) >> (d * 8)) & 0xff;
+		int sameDigit = 0;
+		for (int t = 0; t < threads; t++) {
+			sameDigit += counts[t][d * 256 + firstDigit];
+		}
+		if (sameDigit == n) {
+			continue;
+		}
+
+		// the first counts are from the data as it was before any pass, later passes moved the elements between chunks
+		if (!firstPass) {
+			runThreads(threads, [&](int t) {
+				int *count = counts[t].data() + d * 256;
+				memset(count, 0, 256 * sizeof(int));
+				for (int c = int((long long)n * t / threads); c < int((long long)n * (t + 1) / threads); c++) {
+					++count[(radixKey(data[c]) >> (d * 8)) & 0xff];
+				}
+			});
+		}
+		firstPass = false;
+
+		// turn the counts into the first output position of each thread for each digit
+		int sum = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			for (int t = 0; t < threads; t++) {
+				int &count = counts[t][d * 256 + digit];
+				const int size = count;
+				count = sum;
+				sum += size;
+			}
+		}
+
+		runThreads(threads, [&](int t) {
+			const int lineSize = combineSize<T>();
+			int *position = counts[t].data() + d * 256;
+			std::vector<T> buffer(256 * lineSize);
+			// the buffer of a digit maps to the cache line of the output at lineStart, the region of the digit
+			// can begin inside a line, then the part of the line before begin belongs to someone else and is not written
+			int lineStart[256], begin[256], fill[256];
+			for (int digit = 0; digit < 256; digit++) {
+				const int misaligned = int(reinterpret_cast<uintptr_t>(output.data() + position[digit]) % 64 / sizeof(T));
+				lineStart[digit] = position[digit] - misaligned;
+				begin[digit] = fill[digit] = misaligned;
+			}
+			for (int c = int((long long)n * t / threads); c < int((long long)n * (t + 1) / threads); c++) {
+				const int digit = (radixKey(data[c]) >> (d * 8)) & 0xff;
+				T *line = buffer.data() + digit * lineSize;
+				line[fill[digit]++] = data[c];
+				if (fill[digit] == lineSize) {
+					T *target = output.data() + lineStart[digit] + begin[digit];
+					if (begin[digit] == 0) {
+						streamLine(target, line);
+					} else {
+						memcpy(target, line + begin[digit], sizeof(T) * (lineSize - begin[digit]));
+					}
+					lineStart[digit] += lineSize;
+					begin[digit] = fill[digit] = 0;
+				}
+			}
+			for (int digit = 0; digit < 256; digit++) {
+				const T *line = buffer.data() + digit * lineSize;
+				memcpy(output.data() + lineStart[digit] + begin[digit], line + begin[digit], sizeof(T) * (fill[digit] - begin[digit]));
+			}
+			streamFence();
+		});
+		data.swap(output);
+	}
+}
+}
+
 namespace Base2InPlace {
 
 void radixSort2InplaceRec(std::vector<int> &data, int from, int to, int digit) {
@@ -134,10 +366,309 @@ void radixSort2InplaceRec(std::vector<int> &data) {
 }
 
 namespace BaseXInPlace {
-// TODO
+
+/// Buckets up to this size are sorted with insertion sort instead of more radix passes
+const int insertionSortLimit = 32;
+
+/// Sort [from, to) by the full key with insertion sort, for the small buckets
+template <typename T>
+void insertionSort(std::vector<T> &data, int from, int to) {
+	for (int c = from + 1; c < to; c++) {
+		const T value = data[c];
+		int idx = c;
+		while (idx > from && Base256::radixKey(value) < Base256::radixKey(data[idx - 1])) {
+			data[idx] = data[idx - 1];
+			--idx;
+		}
+		data[idx] = value;
+	}
 }
 
-void test(std::mt19937 &generator, int size) {
+/// American flag sort of [from, to) by the byte at shift and the lower ones
+/// Count the digits, compute where each bucket starts and ends, then walk each bucket and swap every element that
+/// belongs elsewhere to the next free place of its bucket, until the element in hand belongs to the current one.
+/// Each element is moved at most once per byte, and nothing is allocated except 2 KB of counts on the stack per level
+template <typename T>
+void americanFlagSortRec(std::vector<T> &data, int from, int to, int shift) {
+	if (to - from <= insertionSortLimit) {
+		insertionSort(data, from, to);
+		return;
+	}
+
+	int counts[256] = {0};
+	for (int c = from; c < to; c++) {
+		++counts[(Base256::radixKey(data[c]) >> shift) & 0xff];
+	}
+
+	// next[b] - first place in bucket b not yet holding an element of b, end[b] - end of bucket b
+	int next[256], end[256];
+	int position = from;
+	for (int b = 0; b < 256; b++) {
+		next[b] = position;
+		position += counts[b];
+		end[b] = position;
+	}
+
+	for (int b = 0; b < 256; b++) {
+		while (next[b] < end[b]) {
+			T value = data[next[b]];
+			int digit = (Base256::radixKey(value) >> shift) & 0xff;
+			while (digit != b) {
+				std::swap(value, data[next[digit]++]);
+				digit = (Base256::radixKey(value) >> shift) & 0xff;
+			}
+			data[next[b]++] = value;
+		}
+	}
+
+	if (shift == 0) {
+		return;
+	}
+	for (int b = 0, start = from; b < 256; start += counts[b], b++) {
+		if (counts[b] > 1) {
+			americanFlagSortRec(data, start, start + counts[b], shift - 8);
+		}
+	}
+}
+
+/// In-place MSD radix sort with 8 bit digits for 32 and 64 bit integers, signed or unsigned, float and double
+/// Unlike the LSD sorts this needs no second buffer, but the moves are swaps in random order so it is usually slower than radixSort256
+template <typename T>
+void americanFlagSort(std::vector<T> &data) {
+	static_assert(std::is_arithmetic<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "americanFlagSort sorts 32 and 64 bit integers, float and double");
+	americanFlagSortRec(data, 0, data.size(), (sizeof(T) - 1) * 8);
+}
+
+}
+
+namespace Records {
+
+/// Stable LSD radix sort of permutation by keyOf(records[permutation[i]]), keyOf must return an integer, float or double
+/// An empty permutation is first filled with 0, 1, .. n - 1. Only the (key, index) pairs are moved between passes, never the records,
+/// and each record is read once, in order, to extract its key. Since the sort is stable, sorting by several keys is done by calling it
+/// for each key starting from the least significant one, e.g. by id and then by time gives an order by time, then by id
+template <typename T, typename KeyOf>
+void radixSortPermutation(const std::vector<T> &records, KeyOf keyOf, std::vector<int> &permutation) {
+	typedef typename std::decay<decltype(keyOf(records[0]))>::type Key;
+	static_assert(std::is_arithmetic<Key>::value, "radixSortPermutation needs integer or floating point keys");
+	typedef decltype(Base256::radixKey(Key())) U;
+	const int n = records.size();
+	if (permutation.empty()) {
+		permutation.resize(n);
+		for (int c = 0; c < n; c++) {
+			permutation[c] = c;
+		}
+	}
+	assert(permutation.size() == records.size());
+	if (n < 2) {
+		return;
+	}
+
+	// keys are read in record order first, then gathered through the permutation from this small array instead of jumping between records
+	std::vector<U> recordKeys(n);
+	for (int c = 0; c < n; c++) {
+		recordKeys[c] = Base256::radixKey(keyOf(records[c]));
+	}
+
+	// key and index are moved together, so each pass writes to one stream per digit instead of two
+	struct KeyIndex {
+		U key;
+		int index;
+	};
+	std::vector<KeyIndex> pairs(n), output(n);
+	int count[sizeof(U)][256] = {};
+	for (int c = 0; c < n; c++) {
+		pairs[c].key = recordKeys[permutation[c]];
+		pairs[c].index = permutation[c];
+		for (int d = 0; d < int(sizeof(U)); d++) {
+			++count[d][(pairs[c].key >> (d * 8)) & 0xff];
+		}
+	}
+	std::vector<U>().swap(recordKeys);
+
+	for (int d = 0; d < int(sizeof(U)); d++) {
+		if (count[d][(pairs[0].key >> (d * 8)) & 0xff] == n) {
+			continue;
+		}
+		int position = 0;
+		for (int c = 0; c < 256; c++) {
+			const int size = count[d][c];
+			count[d][c] = position;
+			position += size;
+		}
+		for (int c = 0; c < n; c++) {
+			output[count[d][(pairs[c].key >> (d * 8)) & 0xff]++] = pairs[c];
+		}
+		pairs.swap(output);
+	}
+	for (int c = 0; c < n; c++) {
+		permutation[c] = pairs[c].index;
+	}
+}
+
+/// Reorder records so that the new records[i] is the old records[permutation[i]]
+/// Follows the cycles of the permutation so each record is moved once and only one record is held aside.
+/// Visited entries are marked by complementing them and restored at the end, so permutation is unchanged when this returns
+template <typename T>
+void applyPermutation(std::vector<T> &records, std::vector<int> &permutation) {
+	assert(permutation.size() == records.size());
+	const int n = records.size();
+	for (int start = 0; start < n; start++) {
+		if (permutation[start] < 0) {
+			continue;
+		}
+		T held = std::move(records[start]);
+		int idx = start;
+		while (true) {
+			const int source = permutation[idx];
+			permutation[idx] = ~source;
+			if (source == start) {
+				records[idx] = std::move(held);
+				break;
+			}
+			records[idx] = std::move(records[source]);
+			idx = source;
+		}
+	}
+	for (int &value : permutation) {
+		value = ~value;
+	}
+}
+
+/// Stable sort of records by a numeric key, see radixSortPermutation
+template <typename T, typename KeyOf>
+void radixSortRecords(std::vector<T> &records, KeyOf keyOf) {
+	std::vector<int> permutation;
+	radixSortPermutation(records, keyOf, permutation);
+	applyPermutation(records, permutation);
+}
+
+}
+
+namespace Strings {
+
+/// Ranges up to this size are sorted by comparing the strings
+const int smallSortLimit = 16;
+
+/// Sort item, the cached prefix is 8 bytes of the string starting at the current depth
+struct PrefixItem {
+	uint64_t prefix; ///< Big endian so comparing prefixes as integers compares the bytes, zero padded past the end of the string
+	int index; ///< Index of the string
+};
+
+/// Bytes [depth, depth + 8) of value as a big endian integer, zero padded
+inline uint64_t loadPrefix(std::string_view value, size_t depth) {
+	if (value.size() >= depth + 8) {
+		uint64_t bits;
+		memcpy(&bits, value.data() + depth, sizeof(bits));
+#ifdef _MSC_VER
+		return _byteswap_uint64(bits);
+#else
+		return __builtin_bswap64(bits);
+#endif
+	}
+	uint64_t result = 0;
+	for (size_t c = depth; c < depth + 8; c++) {
+		result = (result << 8) | (c < value.size() ? uint8_t(value[c]) : 0);
+	}
+	return result;
+}
+
+/// Insertion sort of a small range, all strings in it share their first depth bytes
+inline void smallSort(const std::vector<std::string_view> &strings, std::vector<PrefixItem> &items, int from, int to, size_t depth) {
+	auto less = [&strings, depth](const PrefixItem &left, const PrefixItem &right) {
+		if (left.prefix != right.prefix) {
+			return left.prefix < right.prefix;
+		}
+		return strings[left.index].substr(depth) < strings[right.index].substr(depth);
+	};
+	for (int c = from + 1; c < to; c++) {
+		const PrefixItem value = items[c];
+		int idx = c;
+		while (idx > from && less(value, items[idx - 1])) {
+			items[idx] = items[idx - 1];
+			--idx;
+		}
+		items[idx] = value;
+	}
+}
+
+/// Multikey quicksort of items [from, to) with 8 byte characters, all strings in the range share their first depth bytes
+/// Partitioning only compares the cached prefixes, so the strings themselves are read once per 8 bytes of depth, when the
+/// prefixes of the range equal to the pivot are reloaded for the next depth
+inline void multikeyQuicksort(const std::vector<std::string_view> &strings, std::vector<PrefixItem> &items, int from, int to, size_t depth) {
+	while (to - from > smallSortLimit) {
+		// median of three prefixes as pivot
+		uint64_t a = items[from].prefix, b = items[from + (to - from) / 2].prefix, c = items[to - 1].prefix;
+		if (a > b) {
+			std::swap(a, b);
+		}
+		const uint64_t pivot = c < a ? a : (c > b ? b : c);
+
+		// three way partition: [from, less) < pivot, [less, greater) == pivot, [greater, to) > pivot
+		int less = from, greater = to;
+		for (int idx = from; idx < greater;) {
+			if (items[idx].prefix < pivot) {
+				std::swap(items[idx++], items[less++]);
+			} else if (items[idx].prefix > pivot) {
+				std::swap(items[idx], items[--greater]);
+			} else {
+				++idx;
+			}
+		}
+		multikeyQuicksort(strings, items, from, less, depth);
+		multikeyQuicksort(strings, items, greater, to, depth);
+
+		// strings that end inside the pivot bytes are prefixes of the longer ones and only differ by length,
+		// move them first ordered by length and continue with the rest on the next 8 bytes
+		int ended = less;
+		for (int idx = less; idx < greater; idx++) {
+			if (strings[items[idx].index].size() <= depth + 8) {
+				std::swap(items[idx], items[ended++]);
+			}
+		}
+		std::sort(items.begin() + less, items.begin() + ended, [&strings](const PrefixItem &left, const PrefixItem &right) {
+			return strings[left.index].size() < strings[right.index].size();
+		});
+		depth += 8;
+		for (int idx = ended; idx < greater; idx++) {
+			items[idx].prefix = loadPrefix(strings[items[idx].index], depth);
+		}
+		from = ended;
+		to = greater;
+	}
+	smallSort(strings, items, from, to, depth);
+}
+
+/// Permutation that sorts strings, the result[i] is the index of the i-th smallest string
+/// Bytes are compared as unsigned like std::string does. Equal strings keep no particular order
+template <typename S>
+std::vector<int> stringSortPermutation(const std::vector<S> &strings) {
+	std::vector<std::string_view> views(strings.begin(), strings.end());
+	std::vector<PrefixItem> items(views.size());
+	for (int c = 0; c < int(views.size()); c++) {
+		items[c].prefix = loadPrefix(views[c], 0);
+		items[c].index = c;
+	}
+	multikeyQuicksort(views, items, 0, int(items.size()), 0);
+
+	std::vector<int> result(items.size());
+	for (int c = 0; c < int(items.size()); c++) {
+		result[c] = items[c].index;
+	}
+	return result;
+}
+
+/// Sort std::string or std::string_view values, the strings are moved once in the end
+template <typename S>
+void stringSort(std::vector<S> &strings) {
+	std::vector<int> permutation = stringSortPermutation(strings);
+	Records::applyPermutation(strings, permutation);
+}
+
+}
+
+void testRadixSortSize(std::mt19937 &generator, int size) {
 	std::vector<int> mine;
 	mine.reserve(size);
 
@@ -159,7 +690,416 @@ void testRadixSort(int maxElements = 10000) {
 	std::mt19937 generator(42);
 	for (int c = 1; c < maxElements; c++) {
 		for (int r = 0; r < 10; r++) {
-			test(generator, c);
+			testRadixSortSize(generator, c);
+		}
+	}
+}
+
+
+/// Compare Base256::radixSort256 with std::sort for random values of T in [low, high]
+template <typename T>
+void testRadixSort256(std::mt19937_64 &generator, int size, T low, T high) {
+	std::uniform_int_distribution<T> dist(low, high);
+	std::vector<T> mine;
+	mine.reserve(size);
+	for (int c = 0; c < size; c++) {
+		mine.push_back(dist(generator));
+	}
+
+	std::vector<T> copy = mine;
+	std::sort(copy.begin(), copy.end());
+	Base256::radixSort256(mine);
+	if (mine != copy) {
+		__debugbreak();
+		assert(false);
+	}
+}
+
+/// Check all four key types with negative values, the extreme values and narrow ranges that skip passes
+void testRadixSort256(int maxElements = 2000) {
+	std::mt19937_64 generator(42);
+	for (int c = 1; c < maxElements; c++) {
+		testRadixSort256<int32_t>(generator, c, INT32_MIN, INT32_MAX);
+		testRadixSort256<int32_t>(generator, c, -100, 100);
+		testRadixSort256<uint32_t>(generator, c, 0, UINT32_MAX);
+		testRadixSort256<int64_t>(generator, c, INT64_MIN, INT64_MAX);
+		testRadixSort256<int64_t>(generator, c, -1000000, 1000000);
+		testRadixSort256<uint64_t>(generator, c, 0, UINT64_MAX);
+		testRadixSort256<uint64_t>(generator, c, 1ull << 40, (1ull << 40) + 255);
+	}
+}
+
+/// Time radixSort256 and std::sort on the same size random values of T in [low, high]
+template <typename T>
+void benchmarkRadixSort256(const char *name, int size, T low, T high) {
+	using namespace std::chrono;
+	std::mt19937_64 generator(42);
+	std::uniform_int_distribution<T> dist(low, high);
+	std::vector<T> mine(size);
+	for (T &value : mine) {
+		value = dist(generator);
+	}
+	std::vector<T> copy = mine;
+
+	steady_clock::time_point start = steady_clock::now();
+	Base256::radixSort256(mine);
+	const double radixMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	start = steady_clock::now();
+	std::sort(copy.begin(), copy.end());
+	const double sortMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	assert(mine == copy);
+	printf("%s: %d elements, radixSort256 %.1f ms, std::sort %.1f ms\n", name, size, radixMs, sortMs);
+}
+
+void benchmarkRadixSort256(int size = 10000000) {
+	benchmarkRadixSort256<int32_t>("int32_t", size, INT32_MIN, INT32_MAX);
+	benchmarkRadixSort256<uint32_t>("uint32_t", size, 0, UINT32_MAX);
+	benchmarkRadixSort256<int64_t>("int64_t", size, INT64_MIN, INT64_MAX);
+	benchmarkRadixSort256<uint64_t>("uint64_t", size, 0, UINT64_MAX);
+	benchmarkRadixSort256<int64_t>("int64_t in [0, 2^32)", size, 0, UINT32_MAX);
+}
+
+
+/// Compare Base256::parallelRadixSort256 with std::sort for a few thread counts, sizes cross the one thread limit
+void testParallelRadixSort256() {
+	std::mt19937_64 generator(42);
+	for (int threads : {1, 3, 8}) {
+		for (int size : {1, 100, 50000, 200001}) {
+			std::uniform_int_distribution<int64_t> dist(INT64_MIN, INT64_MAX);
+			std::vector<int64_t> mine(size);
+			for (int64_t &value : mine) {
+				value = dist(generator) >> (size % 3 * 20);
+			}
+			std::vector<int32_t> small(mine.begin(), mine.end());
+
+			std::vector<int64_t> copy = mine;
+			std::sort(copy.begin(), copy.end());
+			Base256::parallelRadixSort256(mine, threads);
+			std::vector<int32_t> smallCopy = small;
+			std::sort(smallCopy.begin(), smallCopy.end());
+			Base256::parallelRadixSort256(small, threads);
+			if (mine != copy || small != smallCopy) {
+				__debugbreak();
+				assert(false);
+			}
+		}
+	}
+}
+
+/// Sort the same size random uint32_t values with 1, 2, 4 ... maxThreads threads and print the times
+void benchmarkParallelRadixSort256(int size = 100000000, int maxThreads = 64) {
+	using namespace std::chrono;
+	std::mt19937 generator(42);
+	std::vector<uint32_t> original(size);
+	for (uint32_t &value : original) {
+		value = generator();
+	}
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		std::vector<uint32_t> data = original;
+		const steady_clock::time_point start = steady_clock::now();
+		Base256::parallelRadixSort256(data, threads);
+		const double elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+		assert(std::is_sorted(data.begin(), data.end()));
+		printf("%2d threads: %d elements in %.1f ms\n", threads, size, elapsed);
+	}
+}
+
+
+/// Compare BaseXInPlace::americanFlagSort with std::sort, the narrow ranges give many equal keys and single bucket levels
+void testAmericanFlagSort(int maxElements = 2000) {
+	std::mt19937_64 generator(42);
+	for (int c = 1; c < maxElements; c += 7) {
+		for (int r = 0; r < 3; r++) {
+			std::uniform_int_distribution<int64_t> dist(r == 2 ? -5 : INT64_MIN, r == 2 ? 5 : INT64_MAX);
+			std::vector<int64_t> wide(c);
+			for (int64_t &value : wide) {
+				value = dist(generator) >> (r * 30);
+			}
+			std::vector<uint32_t> narrow(wide.begin(), wide.end());
+
+			std::vector<int64_t> wideCopy = wide;
+			std::vector<uint32_t> narrowCopy = narrow;
+			std::sort(wideCopy.begin(), wideCopy.end());
+			std::sort(narrowCopy.begin(), narrowCopy.end());
+			BaseXInPlace::americanFlagSort(wide);
+			BaseXInPlace::americanFlagSort(narrow);
+			if (wide != wideCopy || narrow != narrowCopy) {
+				__debugbreak();
+				assert(false);
+			}
+		}
+	}
+}
+
+/// Time americanFlagSort, radixSort256 and std::sort on the same random int32_t values
+void benchmarkAmericanFlagSort(int size = 10000000) {
+	using namespace std::chrono;
+	std::mt19937 generator(42);
+	std::vector<int32_t> original(size);
+	for (int32_t &value : original) {
+		value = int32_t(generator());
+	}
+
+	std::vector<int32_t> inPlace = original, lsd = original, copy = original;
+	steady_clock::time_point start = steady_clock::now();
+	BaseXInPlace::americanFlagSort(inPlace);
+	const double inPlaceMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	start = steady_clock::now();
+	Base256::radixSort256(lsd);
+	const double lsdMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	start = steady_clock::now();
+	std::sort(copy.begin(), copy.end());
+	const double sortMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	assert(inPlace == copy && lsd == copy);
+	printf("%d elements: americanFlagSort %.1f ms, radixSort256 %.1f ms, std::sort %.1f ms\n", size, inPlaceMs, lsdMs, sortMs);
+}
+
+
+/// Record shaped like the FMICoin transaction, with a memo to make it 128 bytes so moving records is the expensive part
+struct TestTransaction {
+	long long time;
+	unsigned senderId;
+	unsigned receiverId;
+	double fmiCoins;
+	char memo[104];
+};
+
+/// Order by time, then by senderId
+bool transactionLess(const TestTransaction &left, const TestTransaction &right) {
+	return left.time < right.time || (left.time == right.time && left.senderId < right.senderId);
+}
+
+/// Random transactions, fmiCoins holds the initial position so stability can be checked
+std::vector<TestTransaction> makeTransactions(std::mt19937_64 &generator, int size, long long timeRange, unsigned idRange) {
+	std::uniform_int_distribution<long long> time(-timeRange, timeRange);
+	std::uniform_int_distribution<unsigned> id(0, idRange);
+	std::vector<TestTransaction> result(size);
+	for (int c = 0; c < size; c++) {
+		result[c].time = time(generator);
+		result[c].senderId = id(generator);
+		result[c].receiverId = id(generator);
+		result[c].fmiCoins = c;
+		memset(result[c].memo, c & 0xff, sizeof(result[c].memo));
+	}
+	return result;
+}
+
+/// Compare the multi key record sort with std::stable_sort, the small ranges give many equal keys to check stability
+void testRecordSort(int maxElements = 2000) {
+	std::mt19937_64 generator(42);
+	for (int c = 0; c < maxElements; c += 7) {
+		for (long long timeRange : {3ll, 1ll << 40}) {
+			std::vector<TestTransaction> mine = makeTransactions(generator, c, timeRange, 5);
+			std::vector<TestTransaction> copy = mine;
+			std::stable_sort(copy.begin(), copy.end(), transactionLess);
+
+			std::vector<int> permutation;
+			Records::radixSortPermutation(mine, [](const TestTransaction &t) { return t.senderId; }, permutation);
+			Records::radixSortPermutation(mine, [](const TestTransaction &t) { return t.time; }, permutation);
+			Records::applyPermutation(mine, permutation);
+			for (int r = 0; r < c; r++) {
+				if (mine[r].fmiCoins != copy[r].fmiCoins || mine[r].memo[0] != copy[r].memo[0] || permutation[r] != int(copy[r].fmiCoins)) {
+					__debugbreak();
+					assert(false);
+				}
+			}
+
+			// single key sort must keep the time order of equal senders
+			Records::radixSortRecords(mine, [](const TestTransaction &t) { return t.senderId; });
+			std::stable_sort(copy.begin(), copy.end(), [](const TestTransaction &left, const TestTransaction &right) {
+				return left.senderId < right.senderId;
+			});
+			for (int r = 0; r < c; r++) {
+				if (mine[r].fmiCoins != copy[r].fmiCoins) {
+					__debugbreak();
+					assert(false);
+				}
+			}
+		}
+	}
+}
+
+/// Time sorting transactions by time, then by senderId with std::stable_sort, and with the permutation sort and one cycle pass
+void benchmarkRecordSort(int size = 2000000) {
+	using namespace std::chrono;
+	std::mt19937_64 generator(42);
+	std::vector<TestTransaction> mine = makeTransactions(generator, size, 1ll << 40, 1 << 20);
+	std::vector<TestTransaction> copy = mine;
+
+	steady_clock::time_point start = steady_clock::now();
+	std::stable_sort(copy.begin(), copy.end(), transactionLess);
+	const double stableMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	start = steady_clock::now();
+	std::vector<int> permutation;
+	Records::radixSortPermutation(mine, [](const TestTransaction &t) { return t.senderId; }, permutation);
+	Records::radixSortPermutation(mine, [](const TestTransaction &t) { return t.time; }, permutation);
+	const double permutationMs = duration<double, std::milli>(steady_clock::now() - start).count();
+	Records::applyPermutation(mine, permutation);
+	const double radixMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	for (int c = 0; c < size; c++) {
+		assert(mine[c].fmiCoins == copy[c].fmiCoins);
+	}
+	printf("%d %d byte records: std::stable_sort %.1f ms, radix permutation %.1f ms + apply = %.1f ms\n",
+		size, int(sizeof(TestTransaction)), stableMs, permutationMs, radixMs);
+}
+
+
+/// Values of T that stress the float transform: both zeros, infinities, denormals, and random values of all magnitudes and signs
+template <typename T>
+std::vector<T> makeFloats(std::mt19937_64 &generator, int size) {
+	typedef decltype(Base256::radixKey(T())) U;
+	const T special[] = {
+		T(0), -T(0), std::numeric_limits<T>::infinity(), -std::numeric_limits<T>::infinity(),
+		std::numeric_limits<T>::denorm_min(), -std::numeric_limits<T>::denorm_min(),
+		std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest(), T(1), T(-1)
+	};
+	std::uniform_real_distribution<T> small(-1000, 1000);
+	std::vector<T> result(size);
+	for (int c = 0; c < size; c++) {
+		const int kind = generator() % 4;
+		if (kind == 0) {
+			result[c] = special[generator() % (sizeof(special) / sizeof(special[0]))];
+		} else if (kind == 1) {
+			result[c] = small(generator);
+		} else {
+			// random bits, skipping NaNs since they have no order for std::sort
+			U bits = U(generator());
+			memcpy(&result[c], &bits, sizeof(bits));
+			if (result[c] != result[c]) {
+				result[c] = T(kind);
+			}
+		}
+	}
+	return result;
+}
+
+/// Check that sorted floats are ordered by value, -0.0 and +0.0 compare equal for std::sort so only the values are compared
+template <typename T>
+bool sameValues(const std::vector<T> &left, const std::vector<T> &right) {
+	return std::equal(left.begin(), left.end(), right.begin(), right.end());
+}
+
+/// Compare the radix sorts of float and double keys with std::sort
+void testFloatRadixSort(int maxElements = 2000) {
+	std::mt19937_64 generator(42);
+	for (int c = 1; c < maxElements; c += 3) {
+		std::vector<float> floats = makeFloats<float>(generator, c);
+		std::vector<double> doubles = makeFloats<double>(generator, c);
+		std::vector<float> floatsCopy = floats, floatsInPlace = floats;
+		std::vector<double> doublesCopy = doubles, doublesInPlace = doubles;
+		std::sort(floatsCopy.begin(), floatsCopy.end());
+		std::sort(doublesCopy.begin(), doublesCopy.end());
+		Base256::radixSort256(floats);
+		Base256::radixSort256(doubles);
+		BaseXInPlace::americanFlagSort(floatsInPlace);
+		BaseXInPlace::americanFlagSort(doublesInPlace);
+
+		std::vector<int> permutation;
+		Records::radixSortPermutation(doublesCopy, [](double value) { return -value; }, permutation);
+		bool descending = true;
+		for (int r = 1; r < c; r++) {
+			descending = descending && doublesCopy[permutation[r - 1]] >= doublesCopy[permutation[r]];
+		}
+
+		if (!sameValues(floats, floatsCopy) || !sameValues(doubles, doublesCopy) ||
+			!sameValues(floatsInPlace, floatsCopy) || !sameValues(doublesInPlace, doublesCopy) || !descending) {
+			__debugbreak();
+			assert(false);
+		}
+	}
+}
+
+/// Random strings of random length in [minLength, maxLength] from the first letters letters, all starting with common
+std::vector<std::string> makeStrings(std::mt19937_64 &generator, int size, const std::string &common, int minLength, int maxLength, int letters) {
+	std::uniform_int_distribution<int> length(minLength, maxLength);
+	std::vector<std::string> result(size);
+	for (std::string &value : result) {
+		value = common;
+		for (int c = length(generator); c > 0; c--) {
+			value.push_back(char('a' + generator() % letters));
+		}
+	}
+	return result;
+}
+
+/// Compare Strings::stringSort with std::sort, few letters and shared prefixes give many equal strings and strings that are prefixes of others
+void testStringSort(int maxElements = 1000) {
+	std::mt19937_64 generator(42);
+	for (int c = 0; c < maxElements; c += 3) {
+		for (const char *common : {"", "player", "wallet owner number "}) {
+			std::vector<std::string> mine = makeStrings(generator, c, common, 0, 20, c % 2 ? 2 : 26);
+			// bytes above 127 and zero bytes must compare like std::string does
+			if (c > 2) {
+				mine[0].push_back('\0');
+				mine[1].push_back(char(200));
+				mine[2] = mine[0];
+			}
+			std::vector<std::string> copy = mine;
+			std::vector<std::string_view> views(mine.begin(), mine.end());
+			std::sort(copy.begin(), copy.end());
+			// the views point into mine, so they are sorted and checked before mine is reordered
+			Strings::stringSort(views);
+			const bool viewsSorted = std::equal(views.begin(), views.end(), copy.begin(), copy.end());
+			Strings::stringSort(mine);
+			if (mine != copy || !viewsSorted) {
+				__debugbreak();
+				assert(false);
+			}
 		}
 	}
 }
+
+/// Time radixSort256 and std::sort on random float and double values
+void benchmarkFloatRadixSort(int size = 10000000) {
+	using namespace std::chrono;
+	std::mt19937_64 generator(42);
+	std::vector<float> floats = makeFloats<float>(generator, size);
+	std::vector<double> doubles = makeFloats<double>(generator, size);
+	std::vector<float> floatsCopy = floats;
+	std::vector<double> doublesCopy = doubles;
+
+	steady_clock::time_point start = steady_clock::now();
+	Base256::radixSort256(floats);
+	const double floatRadixMs = duration<double, std::milli>(steady_clock::now() - start).count();
+	start = steady_clock::now();
+	std::sort(floatsCopy.begin(), floatsCopy.end());
+	const double floatSortMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	start = steady_clock::now();
+	Base256::radixSort256(doubles);
+	const double doubleRadixMs = duration<double, std::milli>(steady_clock::now() - start).count();
+	start = steady_clock::now();
+	std::sort(doublesCopy.begin(), doublesCopy.end());
+	const double doubleSortMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+	assert(sameValues(floats, floatsCopy) && sameValues(doubles, doublesCopy));
+	printf("float: %d elements, radixSort256 %.1f ms, std::sort %.1f ms\n", size, floatRadixMs, floatSortMs);
+	printf("double: %d elements, radixSort256 %.1f ms, std::sort %.1f ms\n", size, doubleRadixMs, doubleSortMs);
+}
+
+/// Time Strings::stringSort and std::sort on names with and without a shared prefix
+void benchmarkStringSort(int size = 2000000) {
+	using namespace std::chrono;
+	std::mt19937_64 generator(42);
+	for (const char *common : {"", "player_", "card collection owner "}) {
+		std::vector<std::string> mine = makeStrings(generator, size, common, 4, 16, 26);
+		std::vector<std::string> copy = mine;
+
+		steady_clock::time_point start = steady_clock::now();
+		Strings::stringSort(mine);
+		const double radixMs = duration<double, std::milli>(steady_clock::now() - start).count();
+		start = steady_clock::now();
+		std::sort(copy.begin(), copy.end());
+		const double sortMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+		assert(mine == copy);
+		printf("prefix \"%s\": %d strings, stringSort %.1f ms, std::sort %.1f ms\n", common, size, radixMs, sortMs);
+	}
+}